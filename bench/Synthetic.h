@@ -0,0 +1,146 @@
+#pragma once
+#include "Dataset.h"
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Deterministic synthetic datasets for benchmarking (no external data needed).
+struct SyntheticParams {
+    size_t rows = 100000;
+    int attrs = 8;       // continuous attributes
+    int discrete = 0;    // discrete attributes, after the continuous ones
+    int cardinality = 4; // values per discrete attribute
+    int classes = 3;
+    double noise = 0.0;  // fraction of labels replaced by a random class
+    unsigned seed = 1;
+};
+
+// uniform double in [0,1) built only from engine outputs, so it is identical across platforms
+static inline double unit_double(std::mt19937& rng) {
+    return (double)rng() / 4294967296.0;
+}
+
+inline DatasetSpec synthetic_spec(const SyntheticParams& p) {
+    DatasetSpec spec;
+    for (int a=0;a<p.attrs;++a) {
+        AttributeSpec as;
+        as.name = "x" + std::to_string(a);
+        as.is_continuous = true;
+        spec.attrs.push_back(as);
+    }
+    for (int a=0;a<p.discrete;++a) {
+        AttributeSpec as;
+        as.name = "d" + std::to_string(a);
+        for (int v=0;v<p.cardinality;++v) as.values.push_back("v" + std::to_string(v));
+        spec.attrs.push_back(as);
+    }
+    spec.class_name = "Class";
+    for (int k=0;k<p.classes;++k) spec.class_labels.push_back("c" + std::to_string(k));
+    return spec;
+}
+
+// Continuous attributes are uniform in [0,1) (rounded to 3 decimals, so columns have
+// repeated values like real data); discrete ones are uniform over their values. The label
+// buckets a weighted sum of the first few attributes of each kind into `classes` bands.
+// Rows come one at a time, so files larger than memory can be written.
+class SyntheticRows {
+public:
+    explicit SyntheticRows(const SyntheticParams& p) : p_(p), rng_(p.seed) {
+        informative_num_ = p.attrs < 3 ? p.attrs : 3;
+        informative_disc_ = p.discrete < 2 ? p.discrete : 2;
+        for (int a=0;a<informative_num_;++a) max_score_ += (double)(a + 1);
+        for (int a=0;a<informative_disc_;++a) max_score_ += 1.0;
+    }
+
+    // num[0 .. attrs), code[0 .. discrete)
+    void next(double* num, int* code, int& y) {
+        double score = 0.0;
+        for (int a=0;a<p_.attrs;++a) {
+            const double x = (double)(int)(unit_double(rng_) * 1000.0) / 1000.0;
+            num[a] = x;
+            if (a < informative_num_) score += x * (double)(a + 1);
+        }
+        for (int a=0;a<p_.discrete;++a) {
+            const int v = (int)(unit_double(rng_) * p_.cardinality);
+            code[a] = v;
+            if (a < informative_disc_ && p_.cardinality > 1) score += (double)v / (double)(p_.cardinality - 1);
+        }
+        y = max_score_ > 0.0 ? (int)(score / max_score_ * p_.classes) : 0;
+        if (y >= p_.classes) y = p_.classes - 1;
+        if (p_.noise > 0.0 && unit_double(rng_) < p_.noise) y = (int)(rng_() % (unsigned)p_.classes);
+    }
+
+private:
+    SyntheticParams p_;
+    std::mt19937 rng_;
+    int informative_num_ = 0;
+    int informative_disc_ = 0;
+    double max_score_ = 0.0;
+};
+
+inline Dataset make_synthetic(const SyntheticParams& p) {
+    Dataset ds = Dataset::empty(synthetic_spec(p));
+    ds.reserve(p.rows);
+    SyntheticRows gen(p);
+    std::vector<double> num((size_t)p.attrs + 1);
+    std::vector<int> code((size_t)p.discrete + 1);
+    for (size_t r=0;r<p.rows;++r) {
+        int y = 0;
+        gen.next(num.data(), code.data(), y);
+        for (int a=0;a<p.attrs;++a) ds.num[a].push_back(num[a]);
+        for (int a=0;a<p.discrete;++a) ds.code[p.attrs + a].push_back(code[a]);
+        ds.y.push_back(y);
+    }
+    return ds;
+}
+
+// Writes the dataset make_synthetic(p) would build as an attr file and a data file in the
+// text format Dataset::load_spec / load_data read, streaming the rows. Continuous values are
+// printed with 3 decimals, which parse back to exactly the generated doubles.
+inline void write_synthetic(const SyntheticParams& p, const std::string& attr_path, const std::string& data_path) {
+    const DatasetSpec spec = synthetic_spec(p);
+    auto open = [](const std::string& path) {
+        std::FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f) throw std::runtime_error("Failed to open for writing: " + path);
+        return std::unique_ptr<std::FILE, int(*)(std::FILE*)>(f, &std::fclose);
+    };
+
+    auto attr = open(attr_path);
+    for (const AttributeSpec& as : spec.attrs) {
+        std::string line = as.name;
+        if (as.is_continuous) line += " continuous";
+        for (const std::string& v : as.values) line += " " + v;
+        std::fprintf(attr.get(), "%s\n", line.c_str());
+    }
+    std::string class_line = spec.class_name;
+    for (const std::string& c : spec.class_labels) class_line += " " + c;
+    std::fprintf(attr.get(), "\n%s\n", class_line.c_str());
+    if (std::ferror(attr.get())) throw std::runtime_error("Failed to write: " + attr_path);
+
+    auto data = open(data_path);
+    SyntheticRows gen(p);
+    std::vector<double> num((size_t)p.attrs + 1);
+    std::vector<int> code((size_t)p.discrete + 1);
+    std::string line;
+    char buf[32];
+    for (size_t r=0;r<p.rows;++r) {
+        int y = 0;
+        gen.next(num.data(), code.data(), y);
+        line.clear();
+        for (int a=0;a<p.attrs;++a) {
+            std::snprintf(buf, sizeof(buf), "%.3f ", num[a]);
+            line += buf;
+        }
+        for (int a=0;a<p.discrete;++a) {
+            line += spec.attrs[p.attrs + a].values[code[a]];
+            line += ' ';
+        }
+        line += spec.class_labels[y];
+        line += '\n';
+        std::fwrite(line.data(), 1, line.size(), data.get());
+    }
+    if (std::ferror(data.get())) throw std::runtime_error("Failed to write: " + data_path);
+}
@@ -0,0 +1,848 @@
+#include "Dataset.h"
+#include "DecisionTree.h"
+#include "CompiledTree.h"
+#include "CrossVal.h"
+#include "Forest.h"
+#include "Synthetic.h"
+#include "Util.h"
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <thread>
+#include <cerrno>
+#include <sys/stat.h>
+
+// Every heap allocation of the benchmark is counted, for the alloc mode.
+static std::atomic<size_t> g_allocs(0), g_alloc_bytes(0), g_frees(0);
+
+void* operator new(size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    g_alloc_bytes.fetch_add(n, std::memory_order_relaxed);
+    void* p = std::malloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept {
+    if (p) g_frees.fetch_add(1, std::memory_order_relaxed);
+    std::free(p);
+}
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete(p); }
+
+static void usage() {
+    std::cout <<
+R"(Usage:
+  ./dtree_bench presort [--rows 1000000] [--attrs 8] [--classes 3] [--depth 12] [--reps 1]
+  ./dtree_bench hist    [--rows 1000000] [--attrs 8] [--classes 3] [--depth 12] [--reps 1] [--bins 255]
+  ./dtree_bench threads [--rows 1000000] [--attrs 8] [--classes 3] [--depth 12] [--reps 1]
+                        [--max-threads 32] [--split exact|presort|hist]
+  ./dtree_bench predict [--rows 1000000] [--attrs 8] [--classes 3] [--depth 12] [--reps 1]
+  ./dtree_bench rules   [--rows 1000000] [--attrs 8] [--classes 3] [--depth 12] [--reps 1]
+  ./dtree_bench forest  [--rows 1000000] [--attrs 8] [--classes 3] [--depth 12] [--reps 1]
+                        [--trees 32] [--max-threads 32] [--split exact|presort|hist]
+  ./dtree_bench crossval [--rows 1000000] [--attrs 8] [--classes 3] [--depth 12] [--reps 1]
+                        [--folds 10] [--split presort|hist]
+  ./dtree_bench tune    [--rows 1000000] [--attrs 8] [--classes 3] [--depth 12] [--reps 1]
+                        [--split exact|presort|hist]
+  ./dtree_bench stream  [--rows 1000000] [--attrs 8] [--classes 3] [--depth 12] [--reps 1]
+                        [--split exact|presort|hist]
+  ./dtree_bench update  [--rows 1000000] [--attrs 8] [--classes 3] [--depth 12] [--reps 1]
+                        [--batches 10] [--batch-rows 1000] [--split exact|presort]
+  ./dtree_bench gen     [--rows 1000000] [--attrs 8] [--classes 3] --attr <attr-file> --data <data-file>
+  ./dtree_bench suite   [--sizes 1e3,1e4,1e5,1e6] [--attrs 8] [--classes 3] [--depth 12]
+                        [--warmup 1] [--reps 5] [--holdout 0.2] [--split exact|presort|hist]
+                        [--dir bench/generated] [--json results.json] [--csv results.csv]
+  ./dtree_bench alloc   [--rows 1000000] [--attrs 8] [--classes 3] [--depth 12]
+                        [--attr <attr-file> --data <data-file>]
+
+Every mode also accepts --discrete N and --cardinality C to add N discrete attributes with
+C values each, --noise F to replace a fraction F of the labels with random classes, --seed S
+for the generator, and --criterion entropy|gini|gain_ratio (default entropy).
+
+Notes:
+- presort: fits the same synthetic continuous dataset with per-node sorting and with
+  the presorted (sort once in fit) mode, and checks both trees predict identically.
+- hist: fits with per-node sorting and with histogram split finding, and reports
+  training accuracy of both.
+- threads: fits with 1, 2, 4, ... up to --max-threads threads and reports the speedup
+  over one thread; every parallel tree must match the serial one.
+- predict: rows per second of DecisionTree::predict_one vs the compiled (flattened) tree,
+  one row at a time and through predict_batch. All must agree, also on rows with NaNs.
+- rules: rows per second of first-match rule evaluation row by row (predict_one_rules)
+  vs the bitset rule engine (evaluate_rules), over the tree's extracted rules.
+- forest: fits a random forest with 1, 2, 4, ... up to --max-threads threads, reporting fit
+  time, the speedup over one thread and forest vs single-tree training accuracy; every
+  parallel forest must vote exactly like the serial one.
+- crossval: fits the training side of every fold, sorting each fold's columns in its fit
+  vs taking them from orders sorted once over all rows (DecisionTree::presort_columns),
+  and checks both give the same trees.
+- tune: fits a tree for every (depth 1..--depth, minimum split 2/8/32/128) grid point vs
+  fitting the deepest one and truncating it (DecisionTree::truncated), and checks every
+  truncated tree matches its refitted one.
+- stream: fits a tree in batch (fit, in --split mode) and streaming (fit_stream, one pass
+  keeping per-leaf summaries) and reports fit time, size and accuracy on a fresh sample.
+- update: fits an incremental tree on all but the last --batches * --batch-rows rows, adds
+  those in --batches calls to update(), and reports the time per update, how much of the
+  tree it re-checked and refit, and the time of a refit on every row, which must give the
+  same tree. It also checks that rows with a different attr dictionary are rejected.
+- gen: writes the synthetic dataset as an attr file and a data file in the text format
+  the dtree modes read (rows are streamed, so sizes beyond memory are fine).
+- suite: for each of --sizes row counts, writes the synthetic dataset to --dir and times
+  every phase: load (parse the data file), fit (on the training part after holding out
+  --holdout for pruning), predict_one and predict_batch (every row), extract_rules,
+  post_prune_rules (on the held-out part) and evaluate_rules (every row). Each phase runs
+  --warmup untimed times, then --reps timed ones; min, median, mean and max wall time are
+  reported, and written with the configuration to --json and/or --csv for diffing between
+  commits.
+- alloc: heap allocations (operator new calls and bytes) made by fit in each split mode,
+  and the frees and time of destroying the fitted tree. With --attr and --data, the
+  tree is fitted on that dataset instead of synthetic data.
+
+)";
+}
+
+static bool arg_eq(const char* a, const char* b) { return std::strcmp(a,b)==0; }
+
+static unsigned long parse_ulong(const char* s) {
+    char* end=nullptr;
+    unsigned long v = std::strtoul(s, &end, 10);
+    if (end==s || *end!='\0') throw std::runtime_error(std::string("Expected integer, got: ")+s);
+    return v;
+}
+
+// comma-separated row counts; "1e5" style is accepted
+static std::vector<size_t> parse_sizes(const char* s) {
+    std::vector<size_t> out;
+    const char* p = s;
+    while (*p) {
+        char* end = nullptr;
+        const double v = std::strtod(p, &end);
+        if (end == p || v < 1.0 || (*end != ',' && *end != '\0')) {
+            throw std::runtime_error(std::string("Expected row counts like 1e3,1e4, got: ") + s);
+        }
+        out.push_back((size_t)(v + 0.5));
+        p = *end ? end + 1 : end;
+    }
+    return out;
+}
+
+static double now_sec() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct BenchOptions {
+    SyntheticParams data;
+    int depth = 12;
+    int reps = 1;
+    int bins = 255;
+    int max_threads = 32;
+    int trees = 32;
+    int folds = 10;
+    int batches = 10;       // update: batches of new rows
+    size_t batch_rows = 1000;
+    int warmup = 1;
+    double holdout = 0.2;
+    std::vector<size_t> sizes; // suite: row counts, --rows alone when empty
+    std::string dir = "bench/generated";
+    std::string json_file, csv_file;
+    std::string split = "exact";
+    SplitCriterion criterion = SplitCriterion::Entropy;
+    std::string attr_file, data_file; // alloc mode: fit on these instead of synthetic data
+};
+
+static TreeParams params_for_split(const BenchOptions& o) {
+    TreeParams p;
+    p.criterion = o.criterion;
+    p.max_depth = o.depth;
+    if (o.split == "presort") p.presort = true;
+    else if (o.split == "hist") p.hist_bins = o.bins;
+    else if (o.split != "exact") throw std::runtime_error("Unknown split mode: " + o.split);
+    return p;
+}
+
+// Parses the options shared by all bench modes; returns false if argv[i] is not one.
+static bool parse_bench_option(int argc, char** argv, int& i, BenchOptions& o) {
+    if (i+1 >= argc) return false;
+    if (arg_eq(argv[i], "--rows")) { o.data.rows = parse_ulong(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--attrs")) { o.data.attrs = (int)parse_ulong(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--discrete")) { o.data.discrete = (int)parse_ulong(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--cardinality")) { o.data.cardinality = (int)parse_ulong(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--classes")) { o.data.classes = (int)parse_ulong(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--depth")) { o.depth = (int)parse_ulong(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--reps")) { o.reps = (int)parse_ulong(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--bins")) { o.bins = (int)parse_ulong(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--max-threads")) { o.max_threads = (int)parse_ulong(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--trees")) { o.trees = (int)parse_ulong(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--noise")) { o.data.noise = util::to_double(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--seed")) { o.data.seed = (unsigned)parse_ulong(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--warmup")) { o.warmup = (int)parse_ulong(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--holdout")) { o.holdout = util::to_double(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--sizes")) { o.sizes = parse_sizes(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--dir")) { o.dir = argv[++i]; return true; }
+    if (arg_eq(argv[i], "--json")) { o.json_file = argv[++i]; return true; }
+    if (arg_eq(argv[i], "--csv")) { o.csv_file = argv[++i]; return true; }
+    if (arg_eq(argv[i], "--batches")) { o.batches = (int)parse_ulong(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--batch-rows")) { o.batch_rows = parse_ulong(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--folds")) { o.folds = (int)parse_ulong(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--split")) { o.split = argv[++i]; return true; }
+    if (arg_eq(argv[i], "--criterion")) { o.criterion = parse_split_criterion(argv[++i]); return true; }
+    if (arg_eq(argv[i], "--attr")) { o.attr_file = argv[++i]; return true; }
+    if (arg_eq(argv[i], "--data")) { o.data_file = argv[++i]; return true; }
+    return false;
+}
+
+// best-of-reps wall time of fitting `tree` on ds
+static double time_fit(DecisionTree& tree, const Dataset& ds, int reps) {
+    double best = 1e300;
+    for (int r=0;r<reps;++r) {
+        const double t0 = now_sec();
+        tree.fit(ds);
+        const double dt = now_sec() - t0;
+        if (dt < best) best = dt;
+    }
+    return best;
+}
+
+static bool same_predictions(const DecisionTree& a, const DecisionTree& b, const Dataset& ds) {
+    for (size_t i=0;i<ds.size();++i) {
+        if (a.predict_one(ds.spec, ds.row(i)) != b.predict_one(ds.spec, ds.row(i))) return false;
+    }
+    return a.extract_rules(ds.spec).size() == b.extract_rules(ds.spec).size();
+}
+
+static void run_presort(const BenchOptions& o) {
+    const Dataset ds = make_synthetic(o.data);
+    std::cout << "rows=" << ds.size() << " attrs=" << ds.n_attrs()
+              << " classes=" << ds.spec.class_labels.size() << " max_depth=" << o.depth << "\n";
+
+    TreeParams p;
+    p.criterion = o.criterion;
+    p.max_depth = o.depth;
+    DecisionTree exact(p);
+    const double t_exact = time_fit(exact, ds, o.reps);
+
+    p.presort = true;
+    DecisionTree presorted(p);
+    const double t_presort = time_fit(presorted, ds, o.reps);
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "fit (sort per node): " << t_exact << " s\n"
+              << "fit (presorted)    : " << t_presort << " s\n"
+              << "speedup            : " << std::setprecision(2) << t_exact / t_presort << "x\n"
+              << "identical trees    : " << (same_predictions(exact, presorted, ds) ? "yes" : "NO") << "\n";
+}
+
+static void run_hist(const BenchOptions& o) {
+    const Dataset ds = make_synthetic(o.data);
+    std::cout << "rows=" << ds.size() << " attrs=" << ds.n_attrs()
+              << " classes=" << ds.spec.class_labels.size() << " max_depth=" << o.depth
+              << " bins=" << o.bins << "\n";
+
+    TreeParams p;
+    p.criterion = o.criterion;
+    p.max_depth = o.depth;
+    DecisionTree exact(p);
+    const double t_exact = time_fit(exact, ds, o.reps);
+
+    p.hist_bins = o.bins;
+    DecisionTree hist(p);
+    const double t_hist = time_fit(hist, ds, o.reps);
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "fit (exact)    : " << t_exact << " s, train acc " << fmt_pct(exact.evaluate(ds).accuracy()) << "\n"
+              << "fit (histogram): " << t_hist << " s, train acc " << fmt_pct(hist.evaluate(ds).accuracy()) << "\n"
+              << "speedup        : " << std::setprecision(2) << t_exact / t_hist << "x\n";
+}
+
+static void run_threads(const BenchOptions& o) {
+    const Dataset ds = make_synthetic(o.data);
+    std::cout << "rows=" << ds.size() << " attrs=" << ds.n_attrs()
+              << " classes=" << ds.spec.class_labels.size() << " max_depth=" << o.depth
+              << " split=" << o.split << " hardware_threads=" << std::thread::hardware_concurrency() << "\n";
+
+    TreeParams p = params_for_split(o);
+    DecisionTree serial(p);
+    const double t1 = time_fit(serial, ds, o.reps);
+    std::cout << std::fixed << std::setprecision(3)
+              << "threads=1  fit " << t1 << " s\n";
+
+    for (int n=2; n<=o.max_threads; n*=2) {
+        p.n_threads = n;
+        DecisionTree par(p);
+        const double t = time_fit(par, ds, o.reps);
+        std::cout << "threads=" << std::setw(2) << std::left << n << " fit " << t << " s"
+                  << "  speedup " << std::setprecision(2) << t1 / t << "x"
+                  << "  identical " << (same_predictions(serial, par, ds) ? "yes" : "NO")
+                  << std::setprecision(3) << "\n";
+    }
+}
+
+static void run_forest(const BenchOptions& o) {
+    const Dataset ds = make_synthetic(o.data);
+    std::cout << "rows=" << ds.size() << " attrs=" << ds.n_attrs()
+              << " classes=" << ds.spec.class_labels.size() << " max_depth=" << o.depth
+              << " trees=" << o.trees << " split=" << o.split
+              << " hardware_threads=" << std::thread::hardware_concurrency() << "\n";
+
+    ForestParams fp;
+    const int max_features = fp.tree.max_features;
+    fp.tree = params_for_split(o);
+    fp.tree.max_features = max_features;
+    fp.n_trees = o.trees;
+
+    DecisionTree single(params_for_split(o));
+    single.fit(ds);
+
+    std::vector<double> serial_proba;
+    double t1 = 0.0;
+    for (int n=1; n<=o.max_threads; n*=2) {
+        fp.tree.n_threads = n;
+        Forest forest(fp);
+        double best = 1e300;
+        for (int r=0;r<o.reps;++r) {
+            const double t0 = now_sec();
+            forest.fit(ds);
+            best = std::min(best, now_sec() - t0);
+        }
+        std::vector<double> proba(ds.size() * ds.spec.class_labels.size());
+        forest.predict_proba(ds, proba.data());
+        std::cout << std::fixed << std::setprecision(3)
+                  << "threads=" << std::setw(2) << std::left << n << std::right << " fit " << best << " s";
+        if (n == 1) {
+            t1 = best;
+            serial_proba = proba;
+            std::cout << "  train acc forest " << std::setprecision(2) << 100.0 * forest.evaluate(ds).accuracy()
+                      << "% vs tree " << 100.0 * single.evaluate(ds).accuracy() << "%\n";
+        } else {
+            std::cout << "  speedup " << std::setprecision(2) << t1 / best << "x"
+                      << "  identical " << (proba == serial_proba ? "yes" : "NO") << "\n";
+        }
+    }
+}
+
+// best-of-reps rows/s of calling predict(row) over every row of ds; sink defeats dead-code elimination
+template <class Predict>
+static double rows_per_sec(const Dataset& ds, int reps, long& sink, Predict predict) {
+    double best = 1e300;
+    for (int r=0;r<reps;++r) {
+        const double t0 = now_sec();
+        for (size_t i=0;i<ds.size();++i) sink += predict(i);
+        const double dt = now_sec() - t0;
+        if (dt < best) best = dt;
+    }
+    return (double)ds.size() / best;
+}
+
+static void run_predict(const BenchOptions& o) {
+    const Dataset ds = make_synthetic(o.data);
+    TreeParams p = params_for_split(o);
+    DecisionTree tree(p);
+    tree.fit(ds);
+    const CompiledTree& compiled = tree.compiled();
+    std::cout << "rows=" << ds.size() << " attrs=" << ds.n_attrs() << " (discrete " << o.data.discrete << ")"
+              << " classes=" << ds.spec.class_labels.size() << " max_depth=" << o.depth
+              << " nodes=" << compiled.n_nodes() << "\n";
+
+    std::vector<int> batch(ds.size());
+    tree.predict_batch(ds, batch.data());
+    bool same = true;
+    for (size_t i=0;i<ds.size();++i) {
+        const int yp = tree.predict_one(ds.spec, ds.row(i));
+        if (yp != compiled.predict_one(ds.row(i)) || yp != batch[i]) { same = false; break; }
+    }
+    // NaN fails every x <= threshold test, so every path must send it right
+    Dataset nan_ds = ds;
+    for (size_t a=0;a<ds.n_attrs();++a) {
+        if (!ds.spec.attrs[a].is_continuous) continue;
+        double* col = nan_ds.num[a].mutable_data();
+        for (size_t i=a;i<nan_ds.size();i+=ds.n_attrs()+1) col[i] = std::numeric_limits<double>::quiet_NaN();
+    }
+    std::vector<int> nan_batch(nan_ds.size());
+    tree.predict_batch(nan_ds, nan_batch.data());
+    bool same_nan = true;
+    for (size_t i=0;i<nan_ds.size() && same_nan;++i) {
+        const int yp = tree.predict_one(nan_ds.spec, nan_ds.row(i));
+        same_nan = yp == compiled.predict_one(nan_ds.row(i)) && yp == nan_batch[i];
+    }
+
+    long sink = 0;
+    const double r_tree = rows_per_sec(ds, o.reps, sink, [&](size_t i){ return tree.predict_one(ds.spec, ds.row(i)); });
+    const double r_comp = rows_per_sec(ds, o.reps, sink, [&](size_t i){ return compiled.predict_one(ds.row(i)); });
+    double best = 1e300;
+    for (int r=0;r<o.reps;++r) {
+        const double t0 = now_sec();
+        tree.predict_batch(ds, batch.data());
+        best = std::min(best, now_sec() - t0);
+        sink += batch[r % batch.size()];
+    }
+    const double r_batch = (double)ds.size() / best;
+    std::cout << std::fixed << std::setprecision(1)
+              << "predict_one (TreeNode)    : " << r_tree / 1e6 << " M rows/s\n"
+              << "predict_one (CompiledTree): " << r_comp / 1e6 << " M rows/s ("
+              << std::setprecision(2) << r_comp / r_tree << "x)\n" << std::setprecision(1)
+              << "predict_batch             : " << r_batch / 1e6 << " M rows/s ("
+              << std::setprecision(2) << r_batch / r_tree << "x)\n"
+              << "identical predictions     : " << (same ? "yes" : "NO") << "\n"
+              << "identical with NaN inputs : " << (same_nan ? "yes" : "NO") << "\n"
+              << "(checksum " << sink << ")\n";
+}
+
+static void run_rules(const BenchOptions& o) {
+    const Dataset ds = make_synthetic(o.data);
+    TreeParams p = params_for_split(o);
+    DecisionTree tree(p);
+    tree.fit(ds);
+    const auto rules = tree.extract_rules(ds.spec);
+    const int dc = tree.default_class();
+    std::cout << "rows=" << ds.size() << " attrs=" << ds.n_attrs() << " (discrete " << o.data.discrete << ")"
+              << " classes=" << ds.spec.class_labels.size() << " max_depth=" << o.depth
+              << " rules=" << rules.size() << "\n";
+
+    std::vector<int> batch(ds.size());
+    tree.predict_batch_rules(ds, rules, dc, batch.data());
+    bool same = true;
+    int correct = 0;
+    for (size_t i=0;i<ds.size();++i) {
+        const int yp = tree.predict_one_rules(ds.spec, ds.row(i), rules, dc);
+        if (yp != batch[i]) { same = false; break; }
+        if (yp == ds.y[i]) correct += 1;
+    }
+    AccuracyReport acc = tree.evaluate_rules(ds, rules, dc);
+    same = same && acc.correct == correct;
+
+    long sink = 0;
+    const double r_one = rows_per_sec(ds, o.reps, sink, [&](size_t i){ return tree.predict_one_rules(ds.spec, ds.row(i), rules, dc); });
+    double best_eval = 1e300, best_batch = 1e300;
+    for (int r=0;r<o.reps;++r) {
+        double t0 = now_sec();
+        sink += tree.evaluate_rules(ds, rules, dc).correct;
+        best_eval = std::min(best_eval, now_sec() - t0);
+        t0 = now_sec();
+        tree.predict_batch_rules(ds, rules, dc, batch.data());
+        best_batch = std::min(best_batch, now_sec() - t0);
+        sink += batch[r % batch.size()];
+    }
+    const double r_eval = (double)ds.size() / best_eval;
+    const double r_batch = (double)ds.size() / best_batch;
+    std::cout << std::fixed << std::setprecision(1)
+              << "predict_one_rules   : " << r_one / 1e6 << " M rows/s\n"
+              << "predict_batch_rules : " << r_batch / 1e6 << " M rows/s ("
+              << std::setprecision(2) << r_batch / r_one << "x)\n" << std::setprecision(1)
+              << "evaluate_rules      : " << r_eval / 1e6 << " M rows/s ("
+              << std::setprecision(2) << r_eval / r_one << "x)\n"
+              << "identical predictions: " << (same ? "yes" : "NO") << "\n"
+              << "(checksum " << sink << ")\n";
+}
+
+static void run_crossval(const BenchOptions& o) {
+    const Dataset ds = make_synthetic(o.data);
+    BenchOptions so = o;
+    if (so.split == "exact") so.split = "presort";
+    std::cout << "rows=" << ds.size() << " attrs=" << ds.n_attrs()
+              << " classes=" << ds.spec.class_labels.size() << " max_depth=" << o.depth
+              << " folds=" << o.folds << " split=" << so.split << "\n";
+
+    const TreeParams p = params_for_split(so);
+    const std::vector<int> fold_of = assign_folds(ds.size(), o.folds, 1);
+    std::vector<std::vector<int>> train_rows((size_t)o.folds);
+    for (size_t i=0;i<ds.size();++i) {
+        for (int k=0;k<o.folds;++k) if (fold_of[i] != k) train_rows[(size_t)k].push_back((int)i);
+    }
+
+    double best_own = 1e300, best_shared = 1e300, best_sort = 1e300;
+    bool same = true;
+    for (int r=0;r<o.reps;++r) {
+        std::vector<DecisionTree> own, shared;
+        for (int k=0;k<o.folds;++k) { own.emplace_back(p); shared.emplace_back(p); }
+        double t0 = now_sec();
+        for (int k=0;k<o.folds;++k) own[(size_t)k].fit(ds, train_rows[(size_t)k]);
+        best_own = std::min(best_own, now_sec() - t0);
+
+        t0 = now_sec();
+        const DecisionTree::SortedOrders orders = DecisionTree::presort_columns(ds);
+        const double t_sort = now_sec() - t0;
+        for (int k=0;k<o.folds;++k) shared[(size_t)k].fit(ds, train_rows[(size_t)k], &orders);
+        best_shared = std::min(best_shared, now_sec() - t0);
+        best_sort = std::min(best_sort, t_sort);
+
+        for (int k=0;k<o.folds && same && r == 0;++k) same = same_predictions(own[(size_t)k], shared[(size_t)k], ds);
+    }
+    std::cout << std::fixed << std::setprecision(3)
+              << "folds (sort per fold)  : " << best_own << " s\n"
+              << "folds (orders shared)  : " << best_shared << " s (of which sorting " << best_sort << " s)\n"
+              << "speedup                : " << std::setprecision(2) << best_own / best_shared << "x\n"
+              << "identical trees        : " << (same ? "yes" : "NO") << "\n";
+}
+
+static void run_tune(const BenchOptions& o) {
+    const Dataset ds = make_synthetic(o.data);
+    const int min_splits[] = {2, 8, 32, 128};
+    std::cout << "rows=" << ds.size() << " attrs=" << ds.n_attrs()
+              << " classes=" << ds.spec.class_labels.size() << " max_depth=" << o.depth
+              << " split=" << o.split << " grid=" << o.depth * 4 << "\n";
+
+    double best_refit = 1e300, best_trunc = 1e300;
+    bool same = true;
+    for (int r=0;r<o.reps;++r) {
+        std::vector<DecisionTree> refit, trunc;
+        double t0 = now_sec();
+        for (int d=1; d<=o.depth; ++d) {
+            for (int m : min_splits) {
+                TreeParams p = params_for_split(o);
+                p.max_depth = d;
+                p.min_samples_split = m;
+                refit.emplace_back(p);
+                refit.back().fit(ds);
+            }
+        }
+        best_refit = std::min(best_refit, now_sec() - t0);
+
+        t0 = now_sec();
+        DecisionTree deep(params_for_split(o));
+        deep.fit(ds);
+        for (int d=1; d<=o.depth; ++d) {
+            for (int m : min_splits) trunc.push_back(deep.truncated(d, m));
+        }
+        best_trunc = std::min(best_trunc, now_sec() - t0);
+
+        for (size_t j=0; j<refit.size() && same && r == 0; ++j) same = same_predictions(refit[j], trunc[j], ds);
+    }
+    std::cout << std::fixed << std::setprecision(3)
+              << "grid (fit per point)     : " << best_refit << " s\n"
+              << "grid (truncate one tree) : " << best_trunc << " s\n"
+              << "speedup                  : " << std::setprecision(2) << best_refit / best_trunc << "x\n"
+              << "identical trees          : " << (same ? "yes" : "NO") << "\n";
+}
+
+static void run_stream(const BenchOptions& o) {
+    const Dataset ds = make_synthetic(o.data);
+    SyntheticParams test_p = o.data;
+    test_p.rows = std::max<size_t>(o.data.rows / 10, 1000);
+    test_p.seed = o.data.seed + 1;
+    const Dataset test = make_synthetic(test_p);
+    std::cout << "rows=" << ds.size() << " attrs=" << ds.n_attrs()
+              << " classes=" << ds.spec.class_labels.size() << " max_depth=" << o.depth
+              << " split=" << o.split << " test_rows=" << test.size() << "\n";
+
+    DecisionTree batch(params_for_split(o));
+    const double t_batch = time_fit(batch, ds, o.reps);
+
+    HoeffdingParams hp;
+    hp.criterion = o.criterion;
+    hp.max_depth = o.depth;
+    DecisionTree stream;
+    double t_stream = 1e300;
+    for (int r=0;r<o.reps;++r) {
+        const double t0 = now_sec();
+        stream.fit_stream(ds, hp);
+        t_stream = std::min(t_stream, now_sec() - t0);
+    }
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "fit (batch)    : " << t_batch << " s, " << batch.compiled().n_nodes() << " nodes, test acc "
+              << fmt_pct(batch.evaluate(test).accuracy()) << "\n"
+              << "fit (streaming): " << t_stream << " s, " << stream.compiled().n_nodes() << " nodes, test acc "
+              << fmt_pct(stream.evaluate(test).accuracy()) << "\n"
+              << "speedup        : " << std::setprecision(2) << t_batch / t_stream << "x\n";
+}
+
+static void run_update(const BenchOptions& o) {
+    const Dataset ds = make_synthetic(o.data);
+    const size_t n_new = (size_t)o.batches * o.batch_rows;
+    if (n_new >= ds.size()) throw std::runtime_error("update: --batches * --batch-rows must be below --rows");
+    const size_t n_base = ds.size() - n_new;
+    SyntheticParams test_p = o.data;
+    test_p.rows = std::max<size_t>(o.data.rows / 10, 1000);
+    test_p.seed = o.data.seed + 1;
+    const Dataset test = make_synthetic(test_p);
+    std::cout << "rows=" << n_base << "+" << o.batches << "x" << o.batch_rows << " attrs=" << ds.n_attrs()
+              << " classes=" << ds.spec.class_labels.size() << " max_depth=" << o.depth << "\n";
+
+    Dataset base = Dataset::empty(ds.spec);
+    base.reserve(n_base);
+    for (size_t r=0;r<n_base;++r) base.append_row(ds, r);
+    TreeParams p = params_for_split(o);
+    p.incremental = true;
+    DecisionTree tree(p);
+    double t0 = now_sec();
+    tree.fit(base);
+    const double t_fit = now_sec() - t0;
+
+    UpdateReport total;
+    double t_update = 0.0;
+    for (int b=0;b<o.batches;++b) {
+        Dataset batch = Dataset::empty(ds.spec);
+        for (size_t r=0;r<o.batch_rows;++r) batch.append_row(ds, n_base + (size_t)b*o.batch_rows + r);
+        t0 = now_sec();
+        const UpdateReport u = tree.update(batch);
+        t_update += now_sec() - t0;
+        total.nodes_checked += u.nodes_checked;
+        total.subtrees_rebuilt += u.subtrees_rebuilt;
+        total.rows_rescanned += u.rows_rescanned;
+    }
+
+    // rows read with another attr file must be rejected, not indexed into the child tables:
+    // here one more value of a discrete attribute (or one more class)
+    Dataset other = Dataset::empty(ds.spec);
+    other.append_row(ds, 0);
+    bool widened = false;
+    for (auto& a : other.spec.attrs) {
+        if (!a.is_continuous && !widened) { a.values.push_back("unseen"); widened = true; }
+    }
+    if (!widened) other.spec.class_labels.push_back("unseen");
+    bool rejected = false;
+    try { tree.update(other); } catch (const std::runtime_error&) { rejected = true; }
+
+    DecisionTree refit(params_for_split(o));
+    const double t_refit = time_fit(refit, ds, o.reps);
+    std::cout << std::fixed << std::setprecision(3)
+              << "initial fit        : " << t_fit << " s\n"
+              << "update (per batch) : " << t_update / o.batches << " s; " << total.nodes_checked
+              << " splits re-checked, " << total.subtrees_rebuilt << " subtrees refit, "
+              << total.rows_rescanned << " rows rescanned\n"
+              << "refit (all rows)   : " << t_refit << " s\n"
+              << "test acc           : updated " << fmt_pct(tree.evaluate(test).accuracy()) << ", refit "
+              << fmt_pct(refit.evaluate(test).accuracy()) << "\n"
+              << "identical trees    : " << (same_predictions(tree, refit, ds) && same_predictions(tree, refit, test)
+                                             ? "yes" : "NO") << "\n"
+              << "mismatched spec    : " << (rejected ? "rejected" : "ACCEPTED") << "\n";
+}
+
+static void run_gen(const BenchOptions& o) {
+    if (o.attr_file.empty() || o.data_file.empty()) throw std::runtime_error("gen needs --attr and --data output paths");
+    const double t0 = now_sec();
+    write_synthetic(o.data, o.attr_file, o.data_file);
+    std::cout << "wrote " << o.data.rows << " rows to " << o.attr_file << " and " << o.data_file
+              << " in " << std::fixed << std::setprecision(3) << now_sec() - t0 << " s\n";
+}
+
+// Wall times of one suite phase over its timed repetitions.
+struct PhaseResult {
+    size_t rows = 0;   // dataset size
+    std::string phase;
+    size_t items = 0;  // rows the phase processes per run
+    std::vector<double> samples;
+
+    double min() const { return *std::min_element(samples.begin(), samples.end()); }
+    double max() const { return *std::max_element(samples.begin(), samples.end()); }
+    double mean() const {
+        double t = 0.0;
+        for (double x : samples) t += x;
+        return t / (double)samples.size();
+    }
+    double median() const {
+        std::vector<double> v(samples);
+        std::sort(v.begin(), v.end());
+        const size_t n = v.size();
+        return n % 2 ? v[n/2] : 0.5 * (v[n/2 - 1] + v[n/2]);
+    }
+};
+
+// Runs f warmup times untimed, then reps times timed.
+static PhaseResult time_phase(const BenchOptions& o, size_t rows, const std::string& phase, size_t items,
+                              const std::function<void()>& f) {
+    PhaseResult r;
+    r.rows = rows;
+    r.phase = phase;
+    r.items = items;
+    for (int w=0; w<o.warmup; ++w) f();
+    for (int k=0; k<std::max(1, o.reps); ++k) {
+        const double t0 = now_sec();
+        f();
+        r.samples.push_back(now_sec() - t0);
+    }
+    return r;
+}
+
+static std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+static void write_suite_json(const BenchOptions& o, const std::vector<PhaseResult>& results) {
+    std::ofstream out(o.json_file.c_str());
+    if (!out) throw std::runtime_error("Failed to open: " + o.json_file);
+    out << std::setprecision(9);
+    out << "{\n  \"config\": {"
+        << "\"attrs\": " << o.data.attrs << ", \"discrete\": " << o.data.discrete
+        << ", \"cardinality\": " << o.data.cardinality << ", \"classes\": " << o.data.classes
+        << ", \"noise\": " << o.data.noise << ", \"seed\": " << o.data.seed
+        << ", \"split\": \"" << json_escape(o.split) << "\", \"criterion\": \"" << split_criterion_name(o.criterion)
+        << "\", \"depth\": " << o.depth << ", \"holdout\": " << o.holdout
+        << ", \"warmup\": " << o.warmup << ", \"reps\": " << std::max(1, o.reps) << "},\n  \"results\": [";
+    for (size_t i=0;i<results.size();++i) {
+        const PhaseResult& r = results[i];
+        out << (i ? ",\n" : "\n") << "    {\"rows\": " << r.rows << ", \"phase\": \"" << json_escape(r.phase)
+            << "\", \"items\": " << r.items << ", \"min_s\": " << r.min() << ", \"median_s\": " << r.median()
+            << ", \"mean_s\": " << r.mean() << ", \"max_s\": " << r.max()
+            << ", \"items_per_s\": " << (double)r.items / r.min() << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+static void write_suite_csv(const BenchOptions& o, const std::vector<PhaseResult>& results) {
+    std::ofstream out(o.csv_file.c_str());
+    if (!out) throw std::runtime_error("Failed to open: " + o.csv_file);
+    out << std::setprecision(9);
+    out << "rows,attrs,discrete,cardinality,classes,noise,split,criterion,depth,phase,items,reps,"
+           "min_s,median_s,mean_s,max_s,items_per_s\n";
+    for (const PhaseResult& r : results) {
+        out << r.rows << "," << o.data.attrs << "," << o.data.discrete << "," << o.data.cardinality << ","
+            << o.data.classes << "," << o.data.noise << "," << o.split << "," << split_criterion_name(o.criterion) << ","
+            << o.depth << "," << r.phase << "," << r.items << "," << r.samples.size() << ","
+            << r.min() << "," << r.median() << "," << r.mean() << "," << r.max() << ","
+            << (double)r.items / r.min() << "\n";
+    }
+}
+
+static void run_suite(const BenchOptions& o) {
+    std::vector<size_t> sizes = o.sizes;
+    if (sizes.empty()) sizes.push_back(o.data.rows);
+    std::cout << "attrs=" << o.data.attrs << " discrete=" << o.data.discrete << " classes=" << o.data.classes
+              << " noise=" << o.data.noise << " split=" << o.split << " max_depth=" << o.depth
+              << " warmup=" << o.warmup << " reps=" << std::max(1, o.reps) << "\n";
+    std::cout << std::left << std::setw(10) << "rows" << std::setw(18) << "phase" << std::right
+              << std::setw(11) << "min s" << std::setw(11) << "median s" << std::setw(11) << "max s"
+              << std::setw(14) << "M items/s" << "\n";
+
+    if (::mkdir(o.dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Failed to create directory: " + o.dir);
+    }
+
+    std::vector<PhaseResult> results;
+    long sink = 0;
+    for (size_t n : sizes) {
+        SyntheticParams sp = o.data;
+        sp.rows = n;
+        const std::string attr_path = o.dir + "/synthetic-attr.txt";
+        const std::string data_path = o.dir + "/synthetic-" + std::to_string(n) + ".txt";
+        write_synthetic(sp, attr_path, data_path);
+
+        const DatasetSpec spec = Dataset::load_spec(attr_path);
+        Dataset ds;
+        std::vector<PhaseResult> phases;
+        phases.push_back(time_phase(o, n, "load", n, [&]() { ds = Dataset::load_data(spec, data_path); }));
+
+        const auto split = ds.split_holdout(o.holdout, o.data.seed);
+        const Dataset& train = split.first;
+        const Dataset& prune = split.second;
+        DecisionTree tree(params_for_split(o));
+        phases.push_back(time_phase(o, n, "fit", train.size(), [&]() { tree.fit(train); }));
+
+        std::vector<int> pred(ds.size());
+        phases.push_back(time_phase(o, n, "predict_one", n, [&]() {
+            for (size_t i=0;i<ds.size();++i) sink += tree.predict_one(ds.spec, ds.row(i));
+        }));
+        phases.push_back(time_phase(o, n, "predict_batch", n, [&]() {
+            tree.predict_batch(ds, pred.data());
+            sink += pred[0];
+        }));
+
+        std::vector<DecisionTree::Rule> rules, pruned;
+        phases.push_back(time_phase(o, n, "extract_rules", train.size(), [&]() { rules = tree.extract_rules(ds.spec); }));
+        phases.push_back(time_phase(o, n, "post_prune_rules", prune.size(), [&]() {
+            pruned = tree.post_prune_rules(prune, rules, tree.default_class());
+        }));
+        phases.push_back(time_phase(o, n, "evaluate_rules", n, [&]() {
+            sink += tree.evaluate_rules(ds, pruned, tree.default_class()).correct;
+        }));
+
+        for (const PhaseResult& r : phases) {
+            std::cout << std::left << std::setw(10) << n << std::setw(18) << r.phase << std::right
+                      << std::fixed << std::setprecision(6)
+                      << std::setw(11) << r.min() << std::setw(11) << r.median() << std::setw(11) << r.max()
+                      << std::setprecision(2) << std::setw(14) << (double)r.items / r.min() / 1e6 << "\n";
+            results.push_back(r);
+        }
+        std::remove(data_path.c_str());
+    }
+    std::cout << "(checksum " << sink << ")\n";
+    if (!o.json_file.empty()) write_suite_json(o, results);
+    if (!o.csv_file.empty()) write_suite_csv(o, results);
+}
+
+static void run_alloc(const BenchOptions& o) {
+    Dataset ds;
+    if (!o.attr_file.empty() || !o.data_file.empty()) {
+        if (o.attr_file.empty() || o.data_file.empty()) throw std::runtime_error("alloc needs both --attr and --data");
+        ds = Dataset::load_data(Dataset::load_spec(o.attr_file), o.data_file);
+    } else {
+        ds = make_synthetic(o.data);
+    }
+    std::cout << "rows=" << ds.size() << " attrs=" << ds.n_attrs()
+              << " classes=" << ds.spec.class_labels.size() << " max_depth=" << o.depth << "\n";
+
+    const char* splits[] = {"exact", "presort", "hist"};
+    for (const char* split : splits) {
+        BenchOptions so = o;
+        so.split = split;
+        TreeParams p = params_for_split(so);
+        DecisionTree tree(p);
+
+        const size_t a0 = g_allocs, b0 = g_alloc_bytes;
+        tree.fit(ds);
+        const size_t fit_allocs = g_allocs - a0, fit_bytes = g_alloc_bytes - b0;
+        const size_t nodes = tree.compiled().n_nodes();
+
+        // release the fitted tree by moving an empty one over it
+        const size_t f0 = g_frees;
+        const double t0 = now_sec();
+        tree = DecisionTree(p);
+        const double dt = now_sec() - t0;
+        std::cout << std::left << std::setw(8) << split << std::right
+                  << " nodes " << std::setw(8) << nodes
+                  << "  fit allocs " << std::setw(9) << fit_allocs
+                  << "  bytes " << std::setw(11) << fit_bytes
+                  << "  destroy frees " << std::setw(7) << g_frees - f0
+                  << "  " << std::fixed << std::setprecision(1) << dt * 1e6 << " us\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        if (argc < 2) { usage(); return 1; }
+        std::string mode = argv[1];
+        BenchOptions o;
+        o.data.rows = 1000000;
+        if (mode == "suite") o.reps = 5;
+        for (int i=2;i<argc;i++) {
+            if (parse_bench_option(argc, argv, i, o)) {}
+            else { throw std::runtime_error(std::string("Unknown arg: ") + argv[i]); }
+        }
+
+        if (mode == "presort") { run_presort(o); return 0; }
+        if (mode == "hist") { run_hist(o); return 0; }
+        if (mode == "threads") { run_threads(o); return 0; }
+        if (mode == "predict") { run_predict(o); return 0; }
+        if (mode == "rules") { run_rules(o); return 0; }
+        if (mode == "forest") { run_forest(o); return 0; }
+        if (mode == "crossval") { run_crossval(o); return 0; }
+        if (mode == "tune") { run_tune(o); return 0; }
+        if (mode == "stream") { run_stream(o); return 0; }
+        if (mode == "update") { run_update(o); return 0; }
+        if (mode == "gen") { run_gen(o); return 0; }
+        if (mode == "suite") { run_suite(o); return 0; }
+        if (mode == "alloc") { run_alloc(o); return 0; }
+
+        usage();
+        return 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 2;
+    }
+}
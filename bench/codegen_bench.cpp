@@ -0,0 +1,113 @@
+// Times the branch-compiled model written by `dtree export` (included as model.h) against
+// DecisionTree::predict_one and predict_one_rules. The tree is refitted here with the same
+// data, holdout, seed and tree options as the export, so both sides are the same model;
+// every prediction is checked before timing. Built and run by `make codegen-bench`.
+#include "Dataset.h"
+#include "DecisionTree.h"
+#include "Metrics.h"
+#include "TreeOptions.h"
+#include "model.h"
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+static double now_sec() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// best-of-3 rows/s of predict(row) over `passes` passes of n rows; sink defeats dead-code elimination
+template <class Predict>
+static double rows_per_sec(size_t n, int passes, long& sink, Predict predict) {
+    double best = 1e300;
+    for (int r=0;r<3;++r) {
+        const double t0 = now_sec();
+        for (int p=0;p<passes;++p) {
+            for (size_t i=0;i<n;++i) sink += predict(i);
+        }
+        best = std::min(best, now_sec() - t0);
+    }
+    return (double)n * passes / best;
+}
+
+int main(int argc, char** argv) {
+    try {
+        if (argc < 4) {
+            std::cout << "Usage: ./dtree_codegen_bench <attr> <train> <test> [--holdout F] [--seed 1] [--passes 2000] [tree options]\n";
+            return 1;
+        }
+        double holdout = 0.0;
+        unsigned seed = 1;
+        int passes = 2000;
+        TreeParams params;
+        for (int i=4;i<argc;i++) {
+            if (!std::strcmp(argv[i], "--holdout") && i+1<argc) holdout = std::atof(argv[++i]);
+            else if (!std::strcmp(argv[i], "--seed") && i+1<argc) seed = (unsigned)std::atoi(argv[++i]);
+            else if (!std::strcmp(argv[i], "--passes") && i+1<argc) passes = std::atoi(argv[++i]);
+            else if (parse_tree_option(argc, argv, i, params)) {}
+            else throw std::runtime_error(std::string("Unknown arg: ") + argv[i]);
+        }
+
+        // same fit as run_export in main.cpp
+        const DatasetSpec spec = Dataset::load_spec(argv[1]);
+        const Dataset full_train = Dataset::load_data(spec, argv[2]);
+        const Dataset test = Dataset::load_data(spec, argv[3]);
+        Dataset train = full_train, prune;
+        if (holdout > 0.0) {
+            auto split = full_train.split_holdout(holdout, seed);
+            train = split.first;
+            prune = split.second;
+        }
+        DecisionTree tree(params);
+        tree.fit(train);
+        std::vector<DecisionTree::Rule> rules;
+        if (holdout > 0.0) rules = tree.post_prune_rules(prune, tree.extract_rules(spec), tree.default_class());
+
+        // generated code takes one row as x[attr] / c[attr]
+        const size_t A = spec.attrs.size();
+        if ((size_t)dtree_model::N_ATTRS != A) throw std::runtime_error("model.h was generated for another attr file");
+        std::vector<double> x(test.size() * A, 0.0);
+        std::vector<int> c(test.size() * A, 0);
+        for (size_t i=0;i<test.size();++i) {
+            for (size_t a=0;a<A;++a) {
+                if (spec.attrs[a].is_continuous) x[i*A + a] = test.num[a][i];
+                else c[i*A + a] = test.code[a][i];
+            }
+        }
+        auto gen_tree = [&](size_t i) { return dtree_model::predict_tree(&x[i*A], &c[i*A]); };
+        auto one_tree = [&](size_t i) { return tree.predict_one(spec, test.row(i)); };
+
+        bool same = true;
+        for (size_t i=0;i<test.size();++i) same = same && gen_tree(i) == one_tree(i);
+        std::cout << "test rows=" << test.size() << " nodes=" << tree.compiled().n_nodes()
+                  << " rules=" << rules.size() << " passes=" << passes << "\n"
+                  << "identical tree predictions: " << (same ? "yes" : "NO") << "\n";
+
+        long sink = 0;
+        const double r_one = rows_per_sec(test.size(), passes, sink, one_tree);
+        const double r_gen = rows_per_sec(test.size(), passes, sink, gen_tree);
+        std::cout << std::fixed << std::setprecision(1)
+                  << "predict_one (TreeNode)   : " << r_one / 1e6 << " M rows/s\n"
+                  << "predict_tree (generated) : " << r_gen / 1e6 << " M rows/s ("
+                  << std::setprecision(2) << r_gen / r_one << "x)\n";
+        if (dtree_model::HAS_RULES) {
+            auto gen_rules = [&](size_t i) { return dtree_model::predict_rules(&x[i*A], &c[i*A]); };
+            auto one_rules = [&](size_t i) { return tree.predict_one_rules(spec, test.row(i), rules, tree.default_class()); };
+            bool same_r = true;
+            for (size_t i=0;i<test.size();++i) same_r = same_r && gen_rules(i) == one_rules(i);
+            same = same && same_r;
+            const double r_one_r = rows_per_sec(test.size(), passes, sink, one_rules);
+            const double r_gen_r = rows_per_sec(test.size(), passes, sink, gen_rules);
+            std::cout << std::setprecision(1)
+                      << "identical rule predictions: " << (same_r ? "yes" : "NO") << "\n"
+                      << "predict_one_rules        : " << r_one_r / 1e6 << " M rows/s\n"
+                      << "predict_rules (generated): " << r_gen_r / 1e6 << " M rows/s ("
+                      << std::setprecision(2) << r_gen_r / r_one_r << "x)\n";
+        }
+        std::cout << "(checksum " << sink << ")\n";
+        return same ? 0 : 3;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 2;
+    }
+}
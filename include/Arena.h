@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include "Stats.h"
+
+// Bump allocator for the nodes of one tree, their class counts and child tables. Objects
+// are carved out of a few geometrically growing blocks and are never freed one by one;
+// destroying the arena releases every block at once. Only trivially destructible types
+// may live here. allocate() is safe to call from concurrent build tasks.
+class Arena {
+public:
+    Arena() {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t bytes, size_t align) {
+        std::lock_guard<std::mutex> lock(mu_);
+        size_t pad = (align - (uintptr_t)cur_ % align) % align;
+        if (!cur_ || pad + bytes > left_) {
+            size_t n = next_block_;
+            if (n < bytes + align) n = bytes + align;
+            blocks_.emplace_back(new char[n]);
+            cur_ = blocks_.back().get();
+            left_ = n;
+            reserved_ += n;
+            DTREE_STAT_ADD(TREE_BYTES, n);
+            if (next_block_ < MAX_BLOCK) next_block_ *= 2;
+            pad = (align - (uintptr_t)cur_ % align) % align;
+        }
+        char* p = cur_ + pad;
+        cur_ = p + bytes;
+        left_ -= pad + bytes;
+        return p;
+    }
+
+    template <class T>
+    T* make() {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T();
+    }
+    // n value-initialized elements
+    template <class T>
+    T* make_array(size_t n) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        T* p = static_cast<T*>(allocate(sizeof(T) * (n ? n : 1), alignof(T)));
+        for (size_t i = 0; i < n; ++i) new (p + i) T();
+        return p;
+    }
+
+    size_t bytes_reserved() const { return reserved_; }
+    size_t n_blocks() const { return blocks_.size(); }
+
+private:
+    static const size_t FIRST_BLOCK = 4096;
+    static const size_t MAX_BLOCK = 1 << 20;
+
+    std::mutex mu_;
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char* cur_ = nullptr;
+    size_t left_ = 0;
+    size_t next_block_ = FIRST_BLOCK;
+    size_t reserved_ = 0;
+};
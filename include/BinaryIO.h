@@ -0,0 +1,169 @@
+#pragma once
+#include "Dataset.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+// Shared pieces of the binary dataset and model files (native byte order):
+//   header   8-byte magic, u32 version, u32 byte-order mark, u64 count, u64 payload bytes,
+//            u64 payload checksum
+//   payload  sections padded to 8 bytes; strings are u32 length + bytes.
+namespace binio {
+
+static const uint32_t BYTE_ORDER_MARK = 0x01020304u;
+static const size_t HEADER_BYTES = 40;
+
+inline size_t padded(size_t n) { return (n + 7) & ~size_t(7); }
+
+// Word-wise hash over an 8-byte multiple, four independent lanes so it runs near memory speed.
+class Checksum {
+public:
+    void add(const void* p, size_t n) {
+        const unsigned char* b = static_cast<const unsigned char*>(p);
+        for (size_t i=0;i<n;i+=8) {
+            uint64_t w;
+            std::memcpy(&w, b + i, 8);
+            uint64_t& h = lane_[words_++ & 3];
+            h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+            h ^= h >> 31;
+        }
+    }
+    uint64_t value() const {
+        uint64_t h = words_;
+        for (uint64_t l : lane_) h = (h ^ l) * 0xC2B2AE3D27D4EB4FULL;
+        return h ^ (h >> 29);
+    }
+private:
+    uint64_t lane_[4] = {1, 2, 3, 4};
+    uint64_t words_ = 0;
+};
+
+template <class T>
+inline void put(std::string& out, const T& v) { out.append(reinterpret_cast<const char*>(&v), sizeof(T)); }
+inline void put_str(std::string& out, const std::string& s) {
+    put(out, (uint32_t)s.size());
+    out += s;
+}
+inline void pad(std::string& out) { out.resize(padded(out.size()), '\0'); }
+
+// Bounds-checked reads over a byte range; any overrun means a corrupt file.
+struct Reader {
+    const char* p;
+    const char* end;
+    std::string what; // "dataset" / "model", for messages
+    std::string path;
+
+    void fail() const { throw std::runtime_error("Corrupt " + what + " file: " + path); }
+    const char* take(size_t n) {
+        if ((size_t)(end - p) < n) fail();
+        const char* at = p;
+        p += n;
+        return at;
+    }
+    template <class T>
+    T get() {
+        T v;
+        std::memcpy(&v, take(sizeof(T)), sizeof(T));
+        return v;
+    }
+    std::string str() {
+        const uint32_t n = get<uint32_t>();
+        return std::string(take(n), n);
+    }
+    void align(const char* base) { take(padded((size_t)(p - base)) - (size_t)(p - base)); }
+    // n items of at least `bytes` each must fit in what is left, checked before allocating
+    size_t count(uint64_t n, size_t bytes) const {
+        if (n > (uint64_t)(end - p) / bytes) fail();
+        return (size_t)n;
+    }
+};
+
+inline void encode_spec(std::string& out, const DatasetSpec& spec) {
+    put_str(out, spec.class_name);
+    put(out, (uint32_t)spec.class_labels.size());
+    for (const auto& l : spec.class_labels) put_str(out, l);
+    put(out, (uint32_t)spec.attrs.size());
+    for (const auto& a : spec.attrs) {
+        put_str(out, a.name);
+        put(out, (uint32_t)(a.is_continuous ? 1 : 0));
+        put(out, (uint32_t)a.values.size());
+        for (const auto& v : a.values) put_str(out, v);
+    }
+}
+
+inline DatasetSpec decode_spec(Reader& rd) {
+    DatasetSpec spec;
+    spec.class_name = rd.str();
+    for (uint32_t n = rd.get<uint32_t>(); n > 0; --n) spec.class_labels.push_back(rd.str());
+    for (uint32_t n = rd.get<uint32_t>(); n > 0; --n) {
+        AttributeSpec a;
+        a.name = rd.str();
+        a.is_continuous = rd.get<uint32_t>() != 0;
+        for (uint32_t k = rd.get<uint32_t>(); k > 0; --k) a.values.push_back(rd.str());
+        spec.attrs.push_back(a);
+    }
+    return spec;
+}
+
+inline bool same_spec(const DatasetSpec& a, const DatasetSpec& b) {
+    if (a.class_name != b.class_name || a.class_labels != b.class_labels) return false;
+    if (a.attrs.size() != b.attrs.size()) return false;
+    for (size_t i=0;i<a.attrs.size();++i) {
+        const auto& x = a.attrs[i];
+        const auto& y = b.attrs[i];
+        if (x.name != y.name || x.is_continuous != y.is_continuous || x.values != y.values) return false;
+    }
+    return true;
+}
+
+inline void write_header(std::ostream& out, const char magic[8], uint32_t version, uint64_t count,
+                         uint64_t payload, uint64_t checksum) {
+    out.write(magic, 8);
+    out.write(reinterpret_cast<const char*>(&version), 4);
+    out.write(reinterpret_cast<const char*>(&BYTE_ORDER_MARK), 4);
+    out.write(reinterpret_cast<const char*>(&count), 8);
+    out.write(reinterpret_cast<const char*>(&payload), 8);
+    out.write(reinterpret_cast<const char*>(&checksum), 8);
+}
+
+struct Header {
+    uint64_t count = 0;
+    uint64_t checksum = 0;
+};
+
+// Checks magic, byte order, version and payload size (not the checksum).
+inline Header read_header(const MappedFile& file, const char magic[8], uint32_t version,
+                          const std::string& what, const std::string& path) {
+    const char* base = file.begin();
+    if (file.size() < HEADER_BYTES || std::memcmp(base, magic, 8) != 0) {
+        throw std::runtime_error("Not a " + what + " file: " + path);
+    }
+    uint32_t v, bom;
+    uint64_t payload;
+    Header h;
+    std::memcpy(&v, base + 8, 4);
+    std::memcpy(&bom, base + 12, 4);
+    std::memcpy(&h.count, base + 16, 8);
+    std::memcpy(&payload, base + 24, 8);
+    std::memcpy(&h.checksum, base + 32, 8);
+    if (bom != BYTE_ORDER_MARK) throw std::runtime_error("The " + what + " file has a different byte order: " + path);
+    if (v != version) {
+        throw std::runtime_error("Unsupported " + what + " file version " + std::to_string(v) + " in " + path);
+    }
+    if (file.size() - HEADER_BYTES != payload || payload % 8 != 0) {
+        throw std::runtime_error("Corrupt " + what + " file: " + path);
+    }
+    return h;
+}
+
+inline void verify_checksum(const MappedFile& file, const Header& h, const std::string& what,
+                            const std::string& path) {
+    Checksum sum;
+    sum.add(file.begin() + HEADER_BYTES, file.size() - HEADER_BYTES);
+    if (sum.value() != h.checksum) throw std::runtime_error("Checksum mismatch in " + what + " file: " + path);
+}
+
+} // namespace binio
@@ -0,0 +1,20 @@
+#pragma once
+#include "DecisionTree.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Emits a self-contained C++11 header for a fitted tree, and optionally a rule list, in
+// namespace `ns`. The header has:
+//   - compile-time attribute indices (A_<name>), value codes (V_<attr>_<value>) and class
+//     indices (C_<label>), plus CLASS_LABELS;
+//   - predict_tree(x, c): the tree as nested branches, with constexpr thresholds and a
+//     switch on value codes for discrete splits;
+//   - predict_rules(x, c): the first-match rule list as straight-line ifs, falling back to
+//     the default class. Without rules (HAS_RULES false) it only returns the tree's default.
+// x[a] is the value of continuous attribute a and c[a] the value code (index into the attr
+// file's value list) of discrete attribute a; entries of the other kind are ignored. Results
+// equal DecisionTree::predict_one and predict_one_rules.
+void export_cpp_header(std::ostream& out, const DecisionTree& tree,
+                       const std::vector<DecisionTree::Rule>* rules, int rules_default_class,
+                       const std::string& ns);
@@ -0,0 +1,45 @@
+#pragma once
+#include "DecisionTree.h"
+#include <cstdint>
+#include <vector>
+
+// Bitset form of an ordered (first-match) rule list. Each distinct condition is turned
+// into a row bitset at most once per block of rows; a rule's matches are the AND of its
+// conditions' bitsets, and first-match resolution clears the rows earlier rules already
+// claimed (ANDNOT), 64 rows per word. Accuracy is then a popcount against per-class
+// label bitsets, without materialising predictions.
+class CompiledRules {
+public:
+    typedef std::uint64_t Word;
+
+    CompiledRules() {}
+    CompiledRules(const DatasetSpec& spec, const std::vector<DecisionTree::Rule>& rules, int default_class);
+
+    // Predicted class of every row of ds into out[0 .. ds.size()).
+    void predict_batch(const Dataset& ds, int* out) const;
+    // Index of the first rule matching each row, or n_rules() when none does.
+    void match_batch(const Dataset& ds, int* out) const;
+
+    AccuracyReport evaluate(const Dataset& ds) const;
+
+    size_t n_rules() const { return rule_class_.size(); }
+    size_t n_conditions() const { return conds_.size(); }
+
+private:
+    struct Cond {
+        int attr = 0;
+        bool is_cont = false;
+        bool leq = false;   // continuous: x <= threshold (else x > threshold)
+        double threshold = 0.0;
+        int code = -1;      // discrete: value code, -1 never matches
+    };
+    std::vector<Cond> conds_;                 // distinct conditions across all rules
+    std::vector<int> rule_cond_begin_;        // rule r uses rule_conds_[begin[r] .. begin[r+1])
+    std::vector<int> rule_conds_;
+    std::vector<int> rule_class_;
+    int default_class_ = -1;
+
+    Word condition_word(const Dataset& ds, const Cond& c, size_t base, size_t n_rows) const;
+    template <class Visit>
+    void first_match(const Dataset& ds, Visit visit) const;
+};
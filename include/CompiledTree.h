@@ -0,0 +1,81 @@
+#pragma once
+#include "Dataset.h"
+#include "Metrics.h"
+#include <vector>
+
+class DecisionTree;
+namespace binio { struct Reader; }
+
+// Pointer-free inference form of a fitted DecisionTree. Nodes live in one contiguous
+// array in breadth-first order, 16 bytes each. A continuous node's two children are
+// adjacent, so the next node is `child + !(x <= threshold)` (NaN goes right, as in
+// TreeNode). A discrete node's children are a dense table indexed by value code
+// (AttributeSpec::values); values unseen in training point at an extra leaf holding the
+// node's majority class.
+class CompiledTree {
+public:
+    struct Node {
+        double threshold = 0.0; // continuous
+        // >= 0: continuous split on this attribute;
+        // LEAF: leaf;
+        // <= DISCRETE_BASE: discrete split on attribute DISCRETE_BASE - attr
+        int attr = LEAF;
+        // continuous: left child index; discrete: offset into child_table; leaf: predicted class
+        int child = -1;
+    };
+    static const int LEAF = -1;
+    static const int DISCRETE_BASE = -2;
+
+    CompiledTree() {}
+    explicit CompiledTree(const DecisionTree& tree);
+
+    int predict_one(const Example& ex) const;
+
+    // Predicts every row of ds into out[0 .. ds.size()).
+    void predict_batch(const Dataset& ds, int* out) const;
+    // Raw column form: num_cols[a] / code_cols[a] point at n_rows values of attribute a
+    // (entries for attributes of the other kind are ignored and may be null).
+    void predict_batch(const double* const* num_cols, const int* const* code_cols,
+                       size_t n_rows, int* out) const;
+
+    AccuracyReport evaluate(const Dataset& ds) const;
+
+    // Model file section (see Model.h). read() validates the tables against spec, so a
+    // loaded tree cannot index out of range or loop.
+    void write(std::string& out) const;
+    static CompiledTree read(binio::Reader& rd, const DatasetSpec& spec);
+
+    bool empty() const { return nodes_.empty(); }
+    size_t n_nodes() const { return nodes_.size(); }
+    int default_class() const { return default_class_; }
+
+private:
+    std::vector<Node> nodes_;
+    std::vector<int> child_table_;
+    std::vector<int> used_num_cols_; // continuous attributes tested anywhere in the tree
+    bool has_discrete_ = false;
+    int default_class_ = -1;
+
+    void index_columns();
+    void predict_block(const double* const* num_cols, const int* const* code_cols,
+                       size_t row0, size_t n, int* cur) const;
+    void step_discrete(const int* const* code_cols, size_t row0, size_t n, int* cur, bool& moved) const;
+};
+
+inline int CompiledTree::predict_one(const Example& ex) const {
+    if (nodes_.empty()) return default_class_;
+    const Node* nodes = nodes_.data();
+    const Column<double>* num = ex.ds->num.data();
+    const size_t r = ex.index;
+    int i = 0;
+    while (true) {
+        const Node& n = nodes[i];
+        if (n.attr >= 0) {
+            i = n.child + (num[n.attr][r] <= n.threshold ? 0 : 1);
+        } else if (n.attr == LEAF) {
+            return n.child;
+        } else {
+            i = child_table_[n.child + ex.ds->code[DISCRETE_BASE - n.attr][r]];
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "Dataset.h"
+#include "DecisionTree.h"
+#include "Metrics.h"
+#include "TaskPool.h"
+#include <vector>
+
+struct CrossValParams {
+    int folds = 10;
+    unsigned seed = 1;
+    // Fraction of each training fold held out to post-prune the extracted rules; with 0 the
+    // tree is fitted on the whole training fold and the rules are not pruned.
+    double holdout = 0.2;
+    TreeParams tree;
+};
+
+// Test-fold accuracies of one fold's tree, its rules and its post-pruned rules.
+struct FoldScores {
+    AccuracyReport tree, rules, pruned;
+};
+
+// Mean and sample variance of an accuracy over the folds.
+struct AccuracySpread {
+    double mean = 0.0;
+    double variance = 0.0;
+};
+
+struct CrossValResult {
+    std::vector<FoldScores> folds;
+    AccuracySpread tree, rules, pruned;
+};
+
+// Fold index of each of n rows: a seeded shuffle dealt round-robin, so fold sizes differ
+// by at most one.
+std::vector<int> assign_folds(size_t n, int folds, unsigned seed);
+
+// K-fold cross-validation on one loaded dataset. Folds are row-id views of ds, never
+// copies, and are fitted concurrently on pool (in turn without one). In presorted and
+// histogram modes every column is sorted once for all folds, and each fold takes its
+// orders from that. Results do not depend on the pool.
+CrossValResult cross_validate(const Dataset& ds, const CrossValParams& params, TaskPool* pool);
@@ -1,4 +1,6 @@
 #pragma once
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -7,6 +9,9 @@ struct AttributeSpec {
     std::string name;
     bool is_continuous = false;
     std::vector<std::string> values; // for discrete
+
+    // index of a discrete value in `values`, or -1 if it is not declared
+    int value_code(const std::string& v) const;
 };
 
 struct DatasetSpec {
@@ -17,21 +22,140 @@ struct DatasetSpec {
     int class_index(const std::string& y) const;
 };
 
+struct Dataset;
+class TaskPool;
+
+// One typed column. It either owns its values or is a read-only view of values kept alive
+// by a shared backing object (a mapped dataset file). Mutators copy a view into owned
+// storage first, so copies of a Dataset can be modified independently.
+template <class T>
+class Column {
+public:
+    Column() {}
+    Column(const Column& o) : own_(o.own_), data_(o.data_), size_(o.size_), backing_(o.backing_) { rebind(); }
+    Column(Column&& o) : own_(std::move(o.own_)), data_(o.data_), size_(o.size_), backing_(std::move(o.backing_)) {
+        rebind();
+        o.clear();
+    }
+    Column& operator=(Column o) {
+        own_.swap(o.own_);
+        backing_.swap(o.backing_);
+        data_ = o.data_;
+        size_ = o.size_;
+        rebind();
+        return *this;
+    }
+
+    static Column view(const T* data, size_t n, std::shared_ptr<const void> backing) {
+        Column c;
+        c.data_ = data;
+        c.size_ = n;
+        c.backing_ = std::move(backing);
+        return c;
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool is_view() const { return (bool)backing_; }
+    const T* data() const { return data_; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+    const T& operator[](size_t i) const { return data_[i]; }
+
+    T* mutable_data() { detach(); return own_.data(); }
+    void push_back(const T& v) { detach(); own_.push_back(v); rebind(); }
+    void reserve(size_t n) { detach(); own_.reserve(n); rebind(); }
+    void resize(size_t n) { detach(); own_.resize(n); rebind(); }
+
+private:
+    std::vector<T> own_;
+    const T* data_ = nullptr;
+    size_t size_ = 0;
+    std::shared_ptr<const void> backing_;
+
+    void rebind() {
+        if (backing_) return;
+        data_ = own_.data();
+        size_ = own_.size();
+    }
+    void detach() {
+        if (!backing_) return;
+        own_.assign(data_, data_ + size_);
+        backing_.reset();
+        rebind();
+    }
+    void clear() {
+        own_.clear();
+        backing_.reset();
+        rebind();
+    }
+};
+
+// Row-oriented view onto one row of a Dataset's typed columns.
 struct Example {
-    // raw tokens for discrete; for continuous, store string but parsed on demand
-    std::vector<std::string> x;
-    int y = -1; // class index
+    const Dataset* ds = nullptr;
+    size_t index = 0;
+
+    double num(int a) const;               // continuous attribute value
+    int code(int a) const;                 // discrete attribute value, index into AttributeSpec::values
+    const std::string& value(int a) const; // discrete attribute value as a token
+    int y() const;                         // class index
 };
 
 struct Dataset {
     DatasetSpec spec;
-    std::vector<Example> rows;
 
+    // Columns are parsed once at load time (or mapped from a binary dataset file) and
+    // indexed by attribute; the column of the other kind is left empty (num[a] is empty
+    // for discrete a, and vice versa).
+    std::vector<Column<double>> num; // continuous attribute values
+    std::vector<Column<int>> code;   // discrete attribute value codes
+    Column<int> y;                   // class index per row
+
+    // Both loaders also accept a binary dataset file (see save_binary); load_data then
+    // checks that the file's spec matches `spec`.
     static DatasetSpec load_spec(const std::string& attr_path);
-    static Dataset load_data(const DatasetSpec& spec, const std::string& data_path);
+    // With a pool, large files are split into newline-aligned ranges parsed concurrently;
+    // rows and errors are the same as a sequential load.
+    static Dataset load_data(const DatasetSpec& spec, const std::string& data_path, TaskPool* pool = nullptr);
+
+    // Reads data_path ("-" for stdin) once, front to back, handing its rows to f as
+    // consecutive batches of about batch_bytes of text each, so memory stays bounded by the
+    // batch size whatever the input size. Rows and errors are those of load_data. A binary
+    // dataset file is mapped and handed over as one batch.
+    static void stream_data(const DatasetSpec& spec, const std::string& data_path,
+                            const std::function<void(const Dataset&)>& f,
+                            size_t batch_bytes = size_t(1) << 20);
+
+    // Binary dataset file: versioned and checksummed, holding the spec (with its value and
+    // label dictionaries) and the typed columns. Loading maps the file and views the
+    // columns in place, without a parse step.
+    // With `expected`, the file's spec must equal it.
+    void save_binary(const std::string& path) const;
+    static bool is_binary(const std::string& path);
+    static Dataset load_binary(const std::string& path, const DatasetSpec* expected = nullptr);
+    static DatasetSpec load_binary_spec(const std::string& path);
+
+    // An empty dataset with one (empty) column per attribute of spec.
+    static Dataset empty(const DatasetSpec& spec);
 
     // Utility: split rows into train/prune (holdout fraction)
     std::pair<Dataset, Dataset> split_holdout(double holdout_frac, unsigned seed) const;
+    // The same split of a subset of row ids, as (kept, held out) ids in shuffled order;
+    // split_holdout is this over every row.
+    static std::pair<std::vector<int>, std::vector<int>> split_holdout_rows(const std::vector<int>& rows,
+                                                                          double holdout_frac, unsigned seed);
 
+    void reserve(size_t n);
+    // Append row r of src, which must share this dataset's attribute layout.
+    void append_row(const Dataset& src, size_t r);
+
+    Example row(size_t i) const { Example ex; ex.ds = this; ex.index = i; return ex; }
+    size_t size() const { return y.size(); }
     size_t n_attrs() const { return spec.attrs.size(); }
 };
+
+inline double Example::num(int a) const { return ds->num[a][index]; }
+inline int Example::code(int a) const { return ds->code[a][index]; }
+inline const std::string& Example::value(int a) const { return ds->spec.attrs[a].values[ds->code[a][index]]; }
+inline int Example::y() const { return ds->y[index]; }
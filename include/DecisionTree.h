@@ -1,31 +1,82 @@
 #pragma once
+#include "Arena.h"
 #include "Dataset.h"
+#include "Hoeffding.h"
 #include "Metrics.h"
+#include "SplitCriterion.h"
+#include "TaskPool.h"
+#include "CompiledTree.h"
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include <set>
+#include <cstdint>
 
+// Nodes, class counts and child tables live in the owning tree's arena and are released
+// with it, so nodes hold plain pointers.
 struct TreeNode {
     bool is_leaf = false;
 
     // leaf
     int predicted_class = -1;
-    std::vector<int> class_counts;
+    int n_classes = 0;
+    int* class_counts = nullptr; // n_classes entries; update() adds new rows to them
 
     // split
     int attr_index = -1;
     bool is_continuous_split = false;
     double threshold = 0.0; // for continuous
-    // children: for discrete -> map value->child
-    std::unordered_map<std::string, std::unique_ptr<TreeNode>> child_by_value;
+    // children: for discrete -> indexed by value code, null for values with no training rows
+    int n_children = 0;
+    TreeNode** children = nullptr;
     // for continuous -> left/right
-    std::unique_ptr<TreeNode> left;  // <= threshold
-    std::unique_ptr<TreeNode> right; // > threshold
+    TreeNode* left = nullptr;  // <= threshold
+    TreeNode* right = nullptr; // > threshold
+
+    // The lowest impurity left by a split on another attribute (on any attribute, for a leaf
+    // that found no useful split) when the node was last scored, and its row count then.
+    // DecisionTree::update uses them to bound how far the alternatives can have improved.
+    double alt_impurity = 0.0;
+    int checked_rows = 0;
+
+    const TreeNode* child(int code) const {
+        return (code >= 0 && code < n_children) ? children[code] : nullptr;
+    }
 };
 
 struct TreeParams {
+    SplitCriterion criterion = SplitCriterion::Entropy;
     int min_samples_split = 2;
     int max_depth = 1000; // effectively unlimited
+    // SLIQ/SPRINT-style: sort each continuous column once in fit() and keep the sorted
+    // orders through build() by stable partitioning, so nodes scan without sorting.
+    bool presort = false;
+    // Histogram mode when > 0: quantize each continuous column into at most this many
+    // bins by quantiles in fit(), and find splits by scanning per-node class histograms.
+    // Columns with no more distinct values than bins are split exactly.
+    int hist_bins = 0;
+    // Parallel fit when > 1: subtrees with at least parallel_min_rows rows are built as
+    // tasks on a work-stealing pool. The tree is identical to the serial build.
+    int n_threads = 1;
+    int parallel_min_rows = 2048;
+    // Random attribute subsampling (random forests): when > 0, each node scores only
+    // max_features of its available attributes, drawn with a generator seeded from `seed`
+    // and the node's position in the tree, so the tree does not depend on build order.
+    // -1 draws round(sqrt(n_attrs)); 0 scores every attribute.
+    int max_features = 0;
+    unsigned seed = 1;
+    // Keep the training rows and each leaf's rows after fit() so update() can add rows
+    // later. Needs exact split finding: not with hist_bins or max_features.
+    bool incremental = false;
+};
+
+// What one DecisionTree::update did: exact split re-checks of nodes whose margin the new
+// rows could have closed, subtrees refit from their rows, and the rows those two scanned.
+struct UpdateReport {
+    size_t rows = 0;
+    size_t nodes_checked = 0;
+    size_t subtrees_rebuilt = 0;
+    size_t rows_rescanned = 0;
 };
 
 class DecisionTree {
@@ -33,7 +84,48 @@ public:
     explicit DecisionTree(TreeParams p = TreeParams()) : params_(p) {}
 
     void fit(const Dataset& train);
+    // Fit on a multiset of train's rows, e.g. a bootstrap sample; ids may repeat.
+    void fit(const Dataset& train, const std::vector<int>& rows);
+
+    // Per-attribute row ids in ascending value order, ties in row id order (empty for
+    // discrete attrs). In presorted mode every node splits the orders in place like the
+    // row buffer, so a node's rows in value order are the same [first, last) offsets of
+    // each order as of the row buffer.
+    typedef std::vector<std::vector<int>> SortedOrders;
+    // The orders of every row of ds, sorted once for any number of fits on subsets of it.
+    static SortedOrders presort_columns(const Dataset& ds, TaskPool* pool = nullptr);
+    // Fit on rows given presort_columns(train): presorted and histogram modes take each
+    // column's order of `rows` from it in O(n) instead of sorting. With ascending rows the
+    // tree is the same as fit(train, rows).
+    void fit(const Dataset& train, const std::vector<int>& rows, const SortedOrders* presorted);
+    // The tree fit() would build with max_depth and min_samples_split tightened to these
+    // (max_depth no deeper, min_samples_split no smaller than this tree's): a copy of this
+    // tree with every node beyond the limits made a leaf. Split choices do not depend on
+    // either limit, so no refit is needed.
+    DecisionTree truncated(int max_depth, int min_samples_split) const;
+    // Adds labeled rows to a tree fitted with params.incremental. The rows are routed down the
+    // tree, updating the counts of the nodes they reach. A touched node is scored again
+    // (exactly, on its subtree's rows) when its counts and stored statistics show that
+    // another split may now beat its own; a continuous split reached by new rows otherwise
+    // has just its own attribute rescanned, since any row can move its best threshold. A
+    // subtree is refit from its rows if its best split changed. The result is the tree fit()
+    // would build on all rows. new_rows must have the fitted spec (same attr file).
+    UpdateReport update(const Dataset& new_rows);
+
+    // Streaming fit (see Hoeffding.h): reads data_path ("-" for stdin) once, in batches, and
+    // grows the tree as rows arrive, keeping summaries per leaf instead of rows. Node counts
+    // below a continuous split include an estimate of the rows seen before the split.
+    void fit_stream(const DatasetSpec& spec, const std::string& data_path, const HoeffdingParams& p);
+    // the same over the rows of ds, in order
+    void fit_stream(const Dataset& ds, const HoeffdingParams& p);
+    // Fit on an existing pool (shared with other work) instead of one sized by params.n_threads.
+    void set_pool(TaskPool* pool) { pool_ = pool; }
     int predict_one(const DatasetSpec& spec, const Example& ex) const;
+    // Batch inference on the compiled (flattened) tree, many rows at a time;
+    // out must hold ds.size() (or n_rows) predictions.
+    void predict_batch(const Dataset& ds, int* out) const;
+    void predict_batch(const double* const* num_cols, const int* const* code_cols,
+                       size_t n_rows, int* out) const;
     AccuracyReport evaluate(const Dataset& ds) const;
 
     // pretty printing: pre-order, deeper indented, leaves show class distribution
@@ -60,44 +152,157 @@ public:
     // apply rules (first-match). If none matches, use default_class.
     int predict_one_rules(const DatasetSpec& spec, const Example& ex,
                           const std::vector<Rule>& rules, int default_class) const;
+    // batch form of predict_one_rules over every row of ds
+    void predict_batch_rules(const Dataset& ds, const std::vector<Rule>& rules, int default_class,
+                             int* out) const;
     AccuracyReport evaluate_rules(const Dataset& ds, const std::vector<Rule>& rules, int default_class) const;
 
     // rule post-pruning (reduced error pruning on prune_set)
     std::vector<Rule> post_prune_rules(const Dataset& prune_set,
                                        const std::vector<Rule>& rules,
                                        int default_class) const;
+    // the same on the rows prune_rows of ds
+    std::vector<Rule> post_prune_rules(const Dataset& ds, const std::vector<int>& prune_rows,
+                                       const std::vector<Rule>& rules,
+                                       int default_class) const;
 
     static void print_rules(const DatasetSpec& spec, const std::vector<Rule>& rules);
 
     int default_class() const { return default_class_; }
+    const TreeNode* root() const { return root_; }
+    const CompiledTree& compiled() const { return compiled_; }
+    // attribute layout of the dataset the tree was fitted on
+    const DatasetSpec& spec() const { return spec_; }
 
 private:
     TreeParams params_;
-    std::unique_ptr<TreeNode> root_;
+    std::unique_ptr<Arena> arena_; // owns every node of root_; replaced by each fit
+    TreeNode* root_ = nullptr;
     int default_class_ = -1;
+    DatasetSpec spec_;
+    CompiledTree compiled_; // rebuilt whenever root_ changes
+    TaskPool* pool_ = nullptr;
 
-    std::unique_ptr<TreeNode> build(const Dataset& ds, const std::vector<int>& rows,
-                                    const std::vector<int>& avail_attrs, int depth);
+    // update() state: every row fitted so far, each leaf's rows as ids into them (ascending),
+    // and a per-row scratch for build(). Nodes replaced by update() stay in the arena until
+    // the next fit.
+    struct Incremental {
+        Dataset rows;
+        std::unordered_map<const TreeNode*, std::vector<int>> leaf_rows;
+        std::vector<int> route;
+    };
+    std::unique_ptr<Incremental> inc_;
+
+    // A node's rows: the range [first, last) of the fit's row-index buffer. Splitting a node
+    // partitions its range in place, stably, so each child owns a contiguous sub-range and
+    // rows stay in ascending id order within every node.
+    struct RowRange {
+        int* first = nullptr;
+        int* last = nullptr;
+        int* begin() const { return first; }
+        int* end() const { return last; }
+        size_t size() const { return (size_t)(last - first); }
+        bool empty() const { return first == last; }
+    };
+
+    // histogram mode: continuous columns quantized once per fit (empty vectors for discrete attrs)
+    struct Binning {
+        std::vector<std::vector<uint16_t>> bin;  // [attr][row] bin index
+        std::vector<std::vector<double>> lo, hi; // [attr][bin] smallest/largest training value in the bin
+        size_t bin_bytes() const {
+            size_t n = 0;
+            for (const std::vector<uint16_t>& b : bin) n += b.size() * sizeof(uint16_t);
+            return n;
+        }
+    };
+    // per-node class histograms, [attr][bin*K + class] (empty for discrete attrs)
+    typedef std::vector<std::vector<int>> Histograms;
+
+    // State threaded through build(): the fit's task pool (if parallel), the row buffer and
+    // a per-row scratch for the child each row goes to, and optionally the sorted orders in
+    // presorted mode, or the shared binning and the node's histograms in histogram mode.
+    // Subtrees touch disjoint ranges of the buffers, so parallel builds share them.
+    struct NodeAux {
+        TaskPool* pool = nullptr;
+        int* row_base = nullptr;
+        int* route = nullptr; // [row id] child index, written by the row's current node
+        SortedOrders* sorted = nullptr;
+        const Binning* bins = nullptr;
+        Histograms* hist = nullptr; // build() reuses it for one child (parent minus siblings)
+        uint64_t node_seed = 0;     // attribute subsampling: derived from the parent's per child
+        int max_features = 0;       // attribute subsampling: resolved params_.max_features
+    };
+
+    TreeNode* build(const Dataset& ds, RowRange rows,
+                    const std::vector<int>& avail_attrs, int depth,
+                    const NodeAux& aux);
 
     // splitting helpers
-    double entropy_counts(const std::vector<int>& counts) const;
-    int argmax_counts(const std::vector<int>& counts) const;
+    int argmax_counts(const int* counts, size_t K) const;
 
     struct BestSplit {
         int attr = -1;
         bool is_cont = false;
         double threshold = 0.0;
         double gain = -1e9;
-        // for discrete, partitions by value -> row indices
-        std::unordered_map<std::string, std::vector<int>> parts_disc;
-        // for continuous, left/right row indices
-        std::vector<int> left_rows, right_rows;
+        int branches = 0; // non-empty partitions (2 for continuous)
+        int cut_bin = -1; // histogram mode: last bin on the left
+    };
+
+    // one attribute's best split, scored without materializing row partitions
+    struct AttrCandidate {
+        int attr = -1;
+        bool valid = false; // false if the attribute offers no cut at this node
+        bool is_cont = false;
+        double gain = -1e9;
+        int branches = 0;
+        double threshold = 0.0;
+        int cut_bin = -1; // histogram mode: last bin on the left
     };
 
-    BestSplit choose_best_split(const Dataset& ds, const std::vector<int>& rows,
-                                const std::vector<int>& avail_attrs) const;
+    // gain is the criterion's score of the split (gain ratio for SplitCriterion::GainRatio)
+    AttrCandidate eval_attr(const Dataset& ds, RowRange rows, int aidx,
+                            const int* parent_counts, const NodeAux& aux) const;
+    template <class Kernel>
+    AttrCandidate eval_attr_k(const Dataset& ds, RowRange rows, int aidx,
+                              const int* parent_counts, const NodeAux& aux) const;
 
-    std::vector<int> class_counts_for(const Dataset& ds, const std::vector<int>& rows) const;
+    // with runner_up, also the best gain among the other attributes (-1e9 if none)
+    BestSplit choose_best_split(const Dataset& ds, RowRange rows,
+                                const int* parent_counts, const std::vector<int>& avail_attrs,
+                                const NodeAux& aux, double* runner_up = nullptr) const;
+
+    // Partitions the node's rows (and sorted orders) in place by child: value code for a
+    // discrete split, left then right for a continuous one. Returns n_children+1 offsets
+    // into rows; child c owns [first + out[c], first + out[c+1]).
+    std::vector<size_t> partition_rows(const Dataset& ds, RowRange rows, const BestSplit& split,
+                                       const NodeAux& aux) const;
+
+    bool spawn_child(const NodeAux& aux, size_t child_rows) const;
+    // with sorted, values come from its orders (of exactly these rows) instead of sorting
+    Binning make_bins(const Dataset& ds, RowRange rows, const SortedOrders* sorted) const;
+    void fill_histograms(const Dataset& ds, RowRange rows, const Binning& bins,
+                         Histograms& out) const;
+
+    void class_counts_for(const Dataset& ds, RowRange rows, int* counts) const;
+
+    // fit_stream: source calls its argument on each batch of rows in turn
+    typedef std::function<void(const std::function<void(const Dataset&)>&)> StreamSource;
+    void fit_stream_from(const DatasetSpec& spec, const HoeffdingParams& p, const StreamSource& source);
+
+    // update() helpers: node is at depth with avail attrs below its ancestors' splits
+    TreeNode* refresh(TreeNode* node, const std::vector<int>& avail, int depth,
+                      const std::unordered_set<const TreeNode*>& touched, UpdateReport& report);
+    bool split_may_change(const TreeNode* node, int n_rows) const;
+    double impurity(const int* counts, size_t K) const; // per row, by params_.criterion
+    TreeNode* rebuild(TreeNode* node, std::vector<int> rows, const std::vector<int>& avail, int depth,
+                      UpdateReport& report);
+    void collect_rows(const TreeNode* node, std::vector<int>& out) const; // ascending
+    void drop_leaves(const TreeNode* node);
+    void index_leaves(const TreeNode* node, const std::vector<int>& rows);
+
+    // copies src (at depth) into this tree's arena, cut off at params_'s limits
+    TreeNode* copy_truncated(const TreeNode* src, int depth);
 
     void print_node(const DatasetSpec& spec, const TreeNode* node,
                               const std::string& indent, bool is_root) const;
@@ -106,4 +311,8 @@ private:
                            std::vector<Condition>& path, std::vector<Rule>& out) const;
 
     bool rule_matches(const DatasetSpec& spec, const Example& ex, const Rule& r) const;
+
+    // column-wise condition matching; codes[i] is the value code of discrete condition i
+    static std::vector<int> condition_codes(const DatasetSpec& spec, const Rule& r);
+    static bool condition_matches_row(const Dataset& ds, const Condition& c, int code, int rid);
 };
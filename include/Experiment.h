@@ -0,0 +1,48 @@
+#pragma once
+#include "TaskPool.h"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Runs jobs 0..n-1 concurrently on pool (inline without one) and hands each result to
+// emit in job order: a result is emitted once every earlier job has been emitted, whatever
+// order the jobs finish in, so output written from emit is deterministic. emit calls are
+// serialized. If a job or emit throws, no later result is emitted and the first exception is
+// rethrown once the running jobs have finished.
+template <class Result>
+void run_ordered(TaskPool* pool, size_t n, const std::function<Result(size_t)>& job,
+                 const std::function<void(size_t, const Result&)>& emit) {
+    std::vector<std::unique_ptr<Result>> done(n);
+    size_t next = 0;
+    bool failed = false;
+    std::mutex m;
+
+    TaskGroup group(pool);
+    for (size_t i = 0; i < n; ++i) {
+        group.run([&, i]() {
+            std::unique_ptr<Result> r;
+            try {
+                r.reset(new Result(job(i)));
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(m);
+                failed = true;
+                throw;
+            }
+            std::lock_guard<std::mutex> lock(m);
+            done[i] = std::move(r);
+            while (!failed && next < n && done[next]) {
+                try {
+                    emit(next, *done[next]);
+                } catch (...) {
+                    failed = true;
+                    throw;
+                }
+                done[next].reset();
+                ++next;
+            }
+        });
+    }
+    group.wait();
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "Dataset.h"
+#include "DecisionTree.h"
+#include "Metrics.h"
+#include "TaskPool.h"
+#include <functional>
+#include <vector>
+
+struct ForestParams {
+    int n_trees = 100;
+    // Per-tree parameters. max_features defaults to -1 here (round(sqrt(n_attrs)) attributes
+    // scored per node); n_threads is the number of trees fitted at once, each tree itself
+    // being built serially.
+    TreeParams tree;
+    // Each tree is fitted on sample_fraction * n row ids drawn with replacement, or on
+    // every row once without bootstrap.
+    bool bootstrap = true;
+    double sample_fraction = 1.0;
+    unsigned seed = 1;
+
+    ForestParams() { tree.max_features = -1; }
+};
+
+// Bagged ensemble of decision trees; with attribute subsampling, a random forest. Tree i
+// draws its bootstrap sample (as row ids into the training set, not a copied Dataset) and
+// its attribute samples from seeds derived from (seed, i), so the forest is the same for
+// any thread count.
+class Forest {
+public:
+    explicit Forest(ForestParams p = ForestParams()) : params_(p) {}
+
+    void fit(const Dataset& train);
+    // Fit on an existing pool instead of one sized by params.tree.n_threads.
+    void set_pool(TaskPool* pool) { pool_ = pool; }
+
+    // Majority vote of the trees; ties go to the lowest class index.
+    void predict_batch(const Dataset& ds, int* out) const;
+    // Fraction of the trees voting for each class: ds.size() rows of n_classes values.
+    void predict_proba(const Dataset& ds, double* out) const;
+    AccuracyReport evaluate(const Dataset& ds) const;
+
+    size_t n_trees() const { return trees_.size(); }
+    const DecisionTree& tree(size_t i) const { return trees_[i]; }
+    const DatasetSpec& spec() const { return spec_; }
+
+private:
+    ForestParams params_;
+    std::vector<DecisionTree> trees_;
+    DatasetSpec spec_;
+    TaskPool* pool_ = nullptr;
+
+    // Vote counts of every tree for rows [begin, end) of ds, (end - begin) * n_classes
+    // values. Rows are scored a block at a time by each tree's compiled form.
+    void count_votes(const Dataset& ds, size_t begin, size_t end, int* votes) const;
+    // Runs f(begin, end) over blocks of [0, n), concurrently on the pool given to set_pool.
+    void for_blocks(size_t n, const std::function<void(size_t, size_t)>& f) const;
+};
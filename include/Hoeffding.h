@@ -0,0 +1,73 @@
+#pragma once
+#include "Dataset.h"
+#include "SplitCriterion.h"
+#include <vector>
+
+// Streaming training (Hoeffding tree, VFDT): rows are read once and dropped. Each leaf keeps
+// sufficient statistics of the rows that reached it, and is split once the Hoeffding bound
+// shows, with probability 1 - delta, that the best attribute beats the runner-up.
+struct HoeffdingParams {
+    // Entropy or Gini; gain ratio has no fixed range to bound and is rejected
+    SplitCriterion criterion = SplitCriterion::Entropy;
+    double delta = 1e-7;         // allowed chance of choosing a worse attribute
+    double tie_threshold = 0.05; // split anyway once the bound is below this
+    int grace_period = 200;      // rows a leaf takes between split checks
+    int max_depth = 1000;
+    int split_points = 10;       // thresholds tried per continuous attribute
+};
+
+// Bounded summaries of the rows that reached a node, for some of its attributes: class
+// counts per value of a discrete attribute, and per class the count, mean, variance, min
+// and max of a continuous one. The memory used does not depend on the number of rows.
+class SplitStats {
+public:
+    SplitStats() {}
+    SplitStats(const DatasetSpec& spec, const std::vector<int>& attrs);
+
+    void add(const Dataset& ds, size_t r);
+    long rows() const { return n_; }
+    const std::vector<long>& class_counts() const { return class_counts_; }
+    const std::vector<int>& attrs() const { return attrs_; }
+
+    // One attribute's best split: its merit (decrease in impurity) and, if continuous, the
+    // threshold. Discrete merits are exact; continuous ones are estimated at split_points
+    // evenly spaced thresholds, each class's values taken as normal within [min, max].
+    struct Merit {
+        int attr = -1;
+        bool is_cont = false;
+        double merit = 0.0;
+        double threshold = 0.0;
+    };
+    // every attribute that can split the rows, best first (ties by attribute index)
+    std::vector<Merit> merits(SplitCriterion c, int split_points) const;
+    // class counts of child `child` of split m (value code, or 0/1 for <= / >): exact for a
+    // discrete split, estimated and rounded for a continuous one
+    std::vector<int> child_counts(const Merit& m, int child) const;
+
+private:
+    struct Gauss {
+        long n = 0;
+        double mean = 0.0, m2 = 0.0, lo = 0.0, hi = 0.0;
+        void add(double x);
+        double n_leq(double t) const; // estimated rows with value <= t
+    };
+    struct AttrStats {
+        int attr = -1;
+        bool is_cont = false;
+        int n_values = 0;
+        std::vector<long> counts; // discrete: [value*K + class]
+        std::vector<Gauss> gauss; // continuous: [class]
+    };
+
+    int K_ = 0;
+    long n_ = 0;
+    std::vector<long> class_counts_;
+    std::vector<int> attrs_;
+    std::vector<AttrStats> stats_; // parallel to attrs_
+
+    double impurity(SplitCriterion c, const double* counts, double n) const;
+};
+
+// Hoeffding bound after n rows for a criterion over K classes: with probability 1 - delta
+// the true mean of a merit differs from its observed mean by less than this.
+double hoeffding_bound(SplitCriterion c, int n_classes, double delta, long n);
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file. The file is memory-mapped where the platform supports
+// it (falling back to reading it into a buffer), so parsers can scan it in place.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path); // throws "Failed to open file: <path>"
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* begin() const { return data_; }
+    const char* end() const { return data_ + size_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    std::vector<char> buffer_; // contents when the file could not be mapped
+};
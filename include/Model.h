@@ -0,0 +1,27 @@
+#pragma once
+#include "CompiledRules.h"
+#include "CompiledTree.h"
+#include "Dataset.h"
+#include "DecisionTree.h"
+#include <string>
+#include <vector>
+
+// A trained model as stored in a model file: the spec it was trained against, the tree in
+// its compiled inference layout, and optionally a rule set. The file uses the header of
+// BinaryIO.h (count = number of rules) and is checksummed; load() builds the compiled tree
+// and compiled rules straight from it without refitting.
+struct Model {
+    DatasetSpec spec;
+    CompiledTree tree;
+    bool has_rules = false;
+    std::vector<DecisionTree::Rule> rules;
+    int rules_default_class = -1;
+    CompiledRules compiled_rules; // filled by load() and set_rules()
+
+    Model() {}
+    explicit Model(const DecisionTree& tree); // a fitted tree, without rules
+    void set_rules(const std::vector<DecisionTree::Rule>& rules, int default_class);
+
+    void save(const std::string& path) const;
+    static Model load(const std::string& path);
+};
@@ -19,7 +19,7 @@ static inline size_t uniform_index(std::mt19937& rng, size_t n) {
 inline void corrupt_labels(Dataset& ds, double percent, unsigned seed) {
     if (percent <= 0.0) return;
 
-    const size_t N = ds.rows.size();
+    const size_t N = ds.size();
     const size_t K = ds.spec.class_labels.size();
     if (N == 0 || K < 2) return;
 
@@ -38,12 +38,13 @@ inline void corrupt_labels(Dataset& ds, double percent, unsigned seed) {
     }
 
     // flip first k
+    int* labels = ds.y.mutable_data();
     for (size_t t = 0; t < k; ++t) {
-        Example& ex = ds.rows[idx[t]];
+        int& y = labels[idx[t]];
         // pick a new class in [0, K-2], then "skip over" the old label
         size_t r = uniform_index(rng, K - 1);
         int newy = (int)r;
-        if (newy >= ex.y) newy += 1;
-        ex.y = newy;
+        if (newy >= y) newy += 1;
+        y = newy;
     }
 }
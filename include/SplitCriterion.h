@@ -0,0 +1,68 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <string>
+
+// How a node's class counts are scored when choosing a split.
+//   Entropy:   information gain (ID3)
+//   Gini:      decrease in Gini impurity (CART)
+//   GainRatio: information gain over split information (C4.5); thresholds of continuous
+//              attributes are still placed by information gain
+enum class SplitCriterion { Entropy, Gini, GainRatio };
+
+// "entropy", "gini" or "gain_ratio"; throws on anything else
+SplitCriterion parse_split_criterion(const std::string& name);
+const char* split_criterion_name(SplitCriterion c);
+
+namespace criterion {
+
+// c * log2(c) for counts, from a table for small counts
+const int NLOG2N_TABLE = 4096;
+extern double nlog2n_table[NLOG2N_TABLE];
+
+inline double nlog2n(long c) {
+    return c < NLOG2N_TABLE ? nlog2n_table[c] : (double)c * std::log2((double)c);
+}
+
+// Impurity kernels. A side of a split (or a node) with n rows and class counts c_k is scored
+// through an additive per-class term s = sum_k term(c_k), so moving one row across a cut
+// updates s in O(1); weighted(n, s) is n times the side's impurity.
+struct Entropy {
+    static double term(long c) { return nlog2n(c); }
+    static double weighted(long n, double s) { return nlog2n(n) - s; }
+};
+
+struct Gini {
+    static double term(long c) { return (double)c * (double)c; }
+    static double weighted(long n, double s) { return n > 0 ? (double)n - s / (double)n : 0.0; }
+};
+
+// sum_k term(counts[k]); independent partial sums keep long count vectors pipelined
+template <class Kernel>
+double sum_terms(const int* counts, size_t K) {
+    double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    size_t k = 0;
+    for (; k + 4 <= K; k += 4) {
+        s0 += Kernel::term(counts[k]);
+        s1 += Kernel::term(counts[k+1]);
+        s2 += Kernel::term(counts[k+2]);
+        s3 += Kernel::term(counts[k+3]);
+    }
+    for (; k < K; ++k) s0 += Kernel::term(counts[k]);
+    return (s0 + s1) + (s2 + s3);
+}
+
+// impurity of one class-count vector
+template <class Kernel>
+double impurity(const int* counts, size_t K) {
+    long n = 0;
+    for (size_t k = 0; k < K; ++k) n += counts[k];
+    return n > 0 ? Kernel::weighted(n, sum_terms<Kernel>(counts, K)) / (double)n : 0.0;
+}
+
+// entropy of the partition sizes of a split of n rows: C4.5's split information
+inline double split_info(long n, double sum_nlog2n_parts) {
+    return n > 0 ? (nlog2n(n) - sum_nlog2n_parts) / (double)n : 0.0;
+}
+
+} // namespace criterion
@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+
+// Optional instrumentation, compiled in only with -DDTREE_STATS (make STATS=1); otherwise
+// every DTREE_STAT_* macro expands to nothing and the hot paths are unchanged. Counters
+// live per thread and are bumped with plain relaxed loads and stores (no locked
+// instructions); a report sums them over live and finished threads. Phase times are wall
+// time summed over the threads that ran the phase, so nested and parallel phases can add
+// up to more than the elapsed time.
+namespace stats {
+
+enum Counter {
+    NODES_BUILT,
+    CANDIDATE_THRESHOLDS,   // continuous cut points scored
+    NUMBERS_PARSED,         // util::parse_double / to_double calls
+    STRTOD_FALLBACKS,       // of those, the ones off the fast path
+    TREE_BYTES,             // arena blocks reserved for nodes
+    FIT_BUFFER_BYTES,       // per-fit row buffers, sorted orders and bins
+    PRUNE_CONDITION_CHECKS, // rule conditions tested by post_prune_rules
+    PRUNE_TRIALS,           // condition removals scored by post_prune_rules
+    ROWS_PREDICTED_TREE,
+    ROWS_PREDICTED_RULES,
+    N_COUNTERS
+};
+
+enum Phase {
+    PHASE_LOAD,
+    PHASE_FIT,
+    PHASE_CHOOSE_SPLIT,
+    PHASE_EVAL_ATTR, // impurity scans, inside choose_split
+    PHASE_PARTITION,
+    PHASE_PRUNE,
+    PHASE_PREDICT,
+    N_PHASES
+};
+
+// nodes built per depth; deeper nodes are counted in the last slot
+const int MAX_DEPTH = 64;
+
+// whether this build records anything
+bool compiled_in();
+// zeroes every counter; call while no instrumented work is running
+void reset();
+void report(std::ostream& out);
+void report_json(std::ostream& out);
+
+#ifdef DTREE_STATS
+struct ThreadStats {
+    std::atomic<uint64_t> counters[N_COUNTERS];
+    std::atomic<uint64_t> phase_ns[N_PHASES];
+    std::atomic<uint64_t> phase_calls[N_PHASES];
+    std::atomic<uint64_t> depth_nodes[MAX_DEPTH];
+    ThreadStats();
+    ~ThreadStats();
+};
+ThreadStats& local();
+uint64_t now_ns();
+
+// only the owning thread writes its counters, so load + store is enough
+inline void bump(std::atomic<uint64_t>& x, uint64_t n) {
+    x.store(x.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+inline void add(Counter c, uint64_t n) { bump(local().counters[c], n); }
+inline void add_node(int depth) {
+    ThreadStats& t = local();
+    bump(t.counters[NODES_BUILT], 1);
+    bump(t.depth_nodes[depth < MAX_DEPTH - 1 ? depth : MAX_DEPTH - 1], 1);
+}
+
+class ScopedPhase {
+public:
+    explicit ScopedPhase(Phase p) : p_(p), t0_(now_ns()) {}
+    ~ScopedPhase() {
+        ThreadStats& t = local();
+        bump(t.phase_ns[p_], now_ns() - t0_);
+        bump(t.phase_calls[p_], 1);
+    }
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+private:
+    Phase p_;
+    uint64_t t0_;
+};
+
+#define DTREE_STAT_CAT2(a, b) a##b
+#define DTREE_STAT_CAT(a, b) DTREE_STAT_CAT2(a, b)
+#define DTREE_STAT_ADD(counter, n) ::stats::add(::stats::counter, (uint64_t)(n))
+#define DTREE_STAT_NODE(depth) ::stats::add_node(depth)
+#define DTREE_STAT_PHASE(phase) ::stats::ScopedPhase DTREE_STAT_CAT(dtree_stat_phase_, __LINE__)(::stats::phase)
+#else
+#define DTREE_STAT_ADD(counter, n) ((void)0)
+#define DTREE_STAT_NODE(depth) ((void)0)
+#define DTREE_STAT_PHASE(phase) ((void)0)
+#endif
+
+} // namespace stats
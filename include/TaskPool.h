@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing task pool. Each worker owns a deque: it pushes and pops its own tasks at
+// the back (depth-first, cache friendly) and steals from the front of other workers'
+// deques when it runs dry. Tasks submitted from outside the pool go to a shared queue.
+//
+// A pool of n threads starts n-1 workers; the thread waiting on a TaskGroup runs tasks
+// too, so n threads are busy while a fit is in progress.
+class TaskPool {
+public:
+    explicit TaskPool(int n_threads);
+    ~TaskPool();
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    int size() const { return (int)workers_.size() + 1; }
+
+    void push(std::function<void()> task);
+    // Runs one queued task on the calling thread; returns false if none was available.
+    bool try_run_one();
+
+private:
+    struct Queue {
+        std::mutex m;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_; // one per worker
+    Queue injector_;                             // tasks pushed from outside the pool
+    std::vector<std::thread> workers_;
+
+    std::atomic<int> queued_;
+    std::atomic<bool> stop_;
+    std::mutex sleep_m_;
+    std::condition_variable sleep_cv_;
+
+    bool pop(std::function<void()>& task);
+    void worker_loop(int index);
+};
+
+// A set of tasks that can be waited for. Without a pool, tasks run inline in run().
+// The first exception thrown by a task is rethrown from wait().
+class TaskGroup {
+public:
+    explicit TaskGroup(TaskPool* pool) : pool_(pool), pending_(0) {}
+    ~TaskGroup();
+
+    void run(std::function<void()> task);
+    // Blocks until every task of this group has finished, running queued tasks meanwhile.
+    void wait();
+
+private:
+    TaskPool* pool_;
+    std::atomic<int> pending_;
+    std::mutex err_m_;
+    std::exception_ptr err_;
+};
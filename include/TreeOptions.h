@@ -0,0 +1,27 @@
+#pragma once
+#include "DecisionTree.h"
+#include "SplitCriterion.h"
+#include "Util.h"
+#include <cstring>
+#include <string>
+
+// Tree options of the dtree command line, shared with bench/codegen_bench.cpp so it refits
+// the tree `dtree export` wrote with the same parameters.
+
+// Parses a tree option at argv[i] (advancing i past its value); returns false if argv[i] is not one.
+inline bool parse_tree_option(int argc, char** argv, int& i, TreeParams& params) {
+    const auto is = [&](const char* name, bool has_value) {
+        return std::strcmp(argv[i], name) == 0 && (!has_value || i+1 < argc);
+    };
+    if (is("--max-depth", true)) {
+        const std::string v = argv[++i];
+        params.max_depth = v == "all" ? TreeParams().max_depth : (int)util::to_uint(v);
+        return true;
+    }
+    if (is("--min-split", true)) { params.min_samples_split = (int)util::to_uint(argv[++i]); return true; }
+    if (is("--presort", false)) { params.presort = true; return true; }
+    if (is("--bins", true)) { params.hist_bins = (int)util::to_uint(argv[++i]); return true; }
+    if (is("--threads", true)) { params.n_threads = (int)util::to_uint(argv[++i]); return true; }
+    if (is("--criterion", true)) { params.criterion = parse_split_criterion(argv[++i]); return true; }
+    return false;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "Dataset.h"
+#include "DecisionTree.h"
+#include "Metrics.h"
+#include "SplitCriterion.h"
+#include "TaskPool.h"
+#include <vector>
+
+// A grid of tree settings: every combination of criterion, holdout fraction, depth limit
+// and minimum split size is scored.
+struct TuneGrid {
+    std::vector<SplitCriterion> criteria;
+    // Fraction of the training rows held out to post-prune the rules (split_holdout with
+    // seed); 0 fits on every row and leaves the rules unpruned.
+    std::vector<double> holdouts;
+    std::vector<int> max_depths;
+    std::vector<int> min_samples_splits;
+    unsigned seed = 1;
+    TreeParams tree; // everything else: split mode, threads
+};
+
+// Validation accuracies of one grid point.
+struct TunePoint {
+    SplitCriterion criterion = SplitCriterion::Entropy;
+    double holdout = 0.0;
+    int max_depth = 0;
+    int min_samples_split = 0;
+    size_t n_nodes = 0;
+    AccuracyReport tree, rules, pruned;
+};
+
+// Scores every grid point on validate, in grid order (criterion, holdout, depth, minimum
+// split, outermost first). One tree is fitted per (criterion, holdout), with the loosest
+// depth and split limits of the grid; every other point is that tree truncated (see
+// DecisionTree::truncated), identical to fitting it. In presorted and histogram modes the
+// columns of train are sorted once for all fits. Fits, then grid points, run concurrently
+// on pool (in turn without one).
+std::vector<TunePoint> tune(const Dataset& train, const Dataset& validate, const TuneGrid& grid,
+                            TaskPool* pool);
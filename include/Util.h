@@ -6,6 +6,10 @@
 #include <stdexcept>
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "Stats.h"
 
 namespace util {
 
@@ -42,13 +46,77 @@ inline bool ieq(const std::string& a, const std::string& b) {
     return true;
 }
 
-inline double to_double(const std::string& s) {
+// Whitespace as split_ws/trim see it in the C locale.
+inline bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Parses [b, e) as a double exactly as strtod would, requiring the whole range to be
+// consumed. Plain decimals whose digits fit in 53 bits and whose exponent is within
+// 10^+-22 are converted with one correctly rounded multiply or divide (Clinger's fast
+// path); anything else goes through strtod.
+inline bool parse_double(const char* b, const char* e, double& out) {
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    DTREE_STAT_ADD(NUMBERS_PARSED, 1);
+    const char* p = b;
+    bool neg = false;
+    if (p != e && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+    uint64_t mant = 0;
+    int digits = 0, scale = 0;
+    for (; p != e && *p >= '0' && *p <= '9'; ++p, ++digits) mant = mant * 10 + (uint64_t)(*p - '0');
+    if (p != e && *p == '.') {
+        for (++p; p != e && *p >= '0' && *p <= '9'; ++p, ++digits, --scale) mant = mant * 10 + (uint64_t)(*p - '0');
+    }
+    if (p != e && (*p == 'e' || *p == 'E') && digits > 0) {
+        const char* q = p + 1;
+        bool eneg = false;
+        if (q != e && (*q == '-' || *q == '+')) eneg = (*q++ == '-');
+        int ex = 0, edigits = 0;
+        for (; q != e && *q >= '0' && *q <= '9' && edigits < 4; ++q, ++edigits) ex = ex * 10 + (*q - '0');
+        if (edigits > 0) { p = q; scale += eneg ? -ex : ex; }
+    }
+    if (p == e && digits > 0 && digits <= 19 && mant <= (uint64_t(1) << 53) && scale >= -22 && scale <= 22) {
+        double v = (double)mant;
+        v = scale < 0 ? v / pow10[-scale] : v * pow10[scale];
+        out = neg ? -v : v;
+        return true;
+    }
+
+    // strtod needs a terminated string
+    DTREE_STAT_ADD(STRTOD_FALLBACKS, 1);
+    char small[64];
+    std::string big;
+    const size_t n = (size_t)(e - b);
+    const char* s;
+    if (n < sizeof(small)) {
+        std::memcpy(small, b, n);
+        small[n] = '\0';
+        s = small;
+    } else {
+        big.assign(b, e);
+        s = big.c_str();
+    }
     char* end = nullptr;
-    const double v = std::strtod(s.c_str(), &end);
-    if (end == s.c_str() || *end != '\0') {
+    out = std::strtod(s, &end);
+    return end != s && *end == '\0';
+}
+
+inline double to_double(const std::string& s) {
+    double v = 0.0;
+    if (!parse_double(s.data(), s.data() + s.size(), v)) {
         throw std::runtime_error("Expected numeric value, got: " + s);
     }
     return v;
 }
 
+inline unsigned to_uint(const std::string& s) {
+    char* end = nullptr;
+    const unsigned long v = std::strtoul(s.c_str(), &end, 10);
+    if (end == s.c_str() || *end != '\0') throw std::runtime_error("Expected integer, got: " + s);
+    return (unsigned)v;
+}
+
 } // namespace util
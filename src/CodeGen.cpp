@@ -0,0 +1,234 @@
+#include "CodeGen.h"
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+// same tolerance DecisionTree applies to continuous rule conditions
+static const double EPS = 1e-12;
+
+// indentation stops growing past this depth so very deep trees stay readable
+static const int MAX_INDENT = 32;
+
+static std::string exact(double v) {
+    // %g would print inf/nan, which are not C++ literals
+    if (std::isnan(v)) throw std::runtime_error("export: the tree has a NaN threshold");
+    if (std::isinf(v)) return v > 0 ? "std::numeric_limits<double>::infinity()" : "-std::numeric_limits<double>::infinity()";
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%.17g", v);
+    std::string s(buf);
+    if (s.find_first_of(".eEn") == std::string::npos) s += ".0";
+    return s;
+}
+
+static std::string quoted(const std::string& s) {
+    std::string out = "\"";
+    for (char ch : s) {
+        if (ch == '"' || ch == '\\') out += '\\';
+        out += ch;
+    }
+    return out + "\"";
+}
+
+namespace {
+
+// Turns names into unique C++ identifiers with a fixed prefix.
+class Identifiers {
+public:
+    std::string make(const std::string& prefix, const std::string& name) {
+        std::string id = prefix;
+        for (char ch : name) id += std::isalnum(static_cast<unsigned char>(ch)) ? ch : '_';
+        std::string unique = id;
+        for (int k = 2; !used_.insert(unique).second; ++k) unique = id + "_" + std::to_string(k);
+        return unique;
+    }
+private:
+    std::set<std::string> used_;
+};
+
+struct Emitter {
+    std::ostream& out;
+    const DatasetSpec& spec;
+    std::vector<std::string> attr_id;
+    std::vector<std::vector<std::string>> value_id;
+    std::vector<std::string> class_id;
+    std::vector<double> thresholds; // T<i>, in emission order
+
+    void indent(int depth) {
+        for (int i = 0; i < (depth < MAX_INDENT ? depth : MAX_INDENT) + 1; ++i) out << "    ";
+    }
+
+    // declare every tree threshold first so the branches can name them
+    void collect(const TreeNode* n) {
+        if (!n || n->is_leaf) return;
+        if (n->is_continuous_split) {
+            thresholds.push_back(n->threshold);
+            collect(n->left);
+            collect(n->right);
+            return;
+        }
+        for (size_t v = 0; v < spec.attrs[n->attr_index].values.size(); ++v) collect(n->child((int)v));
+    }
+
+    void node(const TreeNode* n, int depth, size_t& next_t) {
+        if (n->is_leaf) {
+            indent(depth);
+            out << "return " << class_id[n->predicted_class] << ";\n";
+            return;
+        }
+        const int a = n->attr_index;
+        if (n->is_continuous_split) {
+            const size_t t = next_t++;
+            indent(depth);
+            out << "if (x[" << attr_id[a] << "] <= T" << t << ") {\n";
+            node(n->left, depth + 1, next_t);
+            indent(depth);
+            out << "} else {\n";
+            node(n->right, depth + 1, next_t);
+            indent(depth);
+            out << "}\n";
+            return;
+        }
+        indent(depth);
+        out << "switch (c[" << attr_id[a] << "]) {\n";
+        const auto& values = spec.attrs[a].values;
+        for (size_t v = 0; v < values.size(); ++v) {
+            const TreeNode* child = n->child((int)v);
+            if (!child) continue;
+            indent(depth);
+            out << "case " << value_id[a][v] << ": {\n";
+            node(child, depth + 1, next_t);
+            indent(depth);
+            out << "}\n";
+        }
+        // values unseen at this node back off to its majority class
+        indent(depth);
+        out << "default: return " << class_id[n->predicted_class] << ";\n";
+        indent(depth);
+        out << "}\n";
+    }
+};
+
+} // namespace
+
+void export_cpp_header(std::ostream& out, const DecisionTree& tree,
+                       const std::vector<DecisionTree::Rule>* rules, int rules_default_class,
+                       const std::string& ns) {
+    const DatasetSpec& spec = tree.spec();
+    Emitter e = {out, spec, {}, {}, {}, {}};
+    Identifiers ids;
+    for (const auto& a : spec.attrs) e.attr_id.push_back(ids.make("A_", a.name));
+    for (size_t a = 0; a < spec.attrs.size(); ++a) {
+        e.value_id.emplace_back();
+        for (const auto& v : spec.attrs[a].values) {
+            e.value_id.back().push_back(ids.make("V_" + e.attr_id[a].substr(2) + "_", v));
+        }
+    }
+    for (const auto& l : spec.class_labels) e.class_id.push_back(ids.make("C_", l));
+
+    out << "// Generated by `dtree export`; do not edit.\n"
+        << "#pragma once\n"
+        << "#include <limits>\n\n"
+        << "namespace " << ns << " {\n\n"
+        << "constexpr int N_ATTRS = " << spec.attrs.size() << ";\n"
+        << "constexpr int N_CLASSES = " << spec.class_labels.size() << ";\n"
+        << "constexpr bool HAS_RULES = " << (rules ? "true" : "false") << ";\n\n";
+
+    out << "// attribute indices: x[A_*] for continuous attributes, c[A_*] for discrete ones\n";
+    for (size_t a = 0; a < spec.attrs.size(); ++a) {
+        out << "constexpr int " << e.attr_id[a] << " = " << a << "; // "
+            << (spec.attrs[a].is_continuous ? "continuous" : "discrete") << "\n";
+    }
+    bool any_values = false;
+    for (size_t a = 0; a < spec.attrs.size(); ++a) {
+        for (size_t v = 0; v < spec.attrs[a].values.size(); ++v) {
+            if (!any_values) out << "\n// discrete value codes\n";
+            any_values = true;
+            out << "constexpr int " << e.value_id[a][v] << " = " << v << ";\n";
+        }
+    }
+    out << "\n// classes\n";
+    for (size_t k = 0; k < spec.class_labels.size(); ++k) {
+        out << "constexpr int " << e.class_id[k] << " = " << k << ";\n";
+    }
+    out << "constexpr const char* CLASS_LABELS[N_CLASSES] = {";
+    for (size_t k = 0; k < spec.class_labels.size(); ++k) out << (k ? ", " : "") << quoted(spec.class_labels[k]);
+    out << "};\n";
+
+    const TreeNode* root = tree.root();
+    e.collect(root);
+    if (!e.thresholds.empty()) out << "\n// split thresholds (go left when x <= T)\n";
+    for (size_t t = 0; t < e.thresholds.size(); ++t) {
+        out << "constexpr double T" << t << " = " << exact(e.thresholds[t]) << ";\n";
+    }
+
+    out << "\ninline int predict_tree(const double* x, const int* c) {\n"
+        << "    (void)x; (void)c;\n";
+    if (root) {
+        size_t next_t = 0;
+        e.node(root, 0, next_t);
+    } else {
+        out << "    return " << tree.default_class() << ";\n";
+    }
+    out << "}\n";
+
+    // without rules this is the empty rule list, which always answers the default class
+    const std::vector<DecisionTree::Rule> no_rules;
+    if (!rules) {
+        rules = &no_rules;
+        rules_default_class = tree.default_class();
+    }
+    {
+        // thresholds carry the rule matcher's tolerance, folded in exactly as it computes it
+        std::map<double, size_t> rule_t;
+        for (const auto& r : *rules) {
+            for (const auto& c : r.conds) {
+                if (!c.is_cont) continue;
+                const double thr = c.threshold + EPS;
+                if (rule_t.count(thr)) continue;
+                const size_t id = rule_t.size();
+                if (id == 0) out << "\n// rule thresholds (threshold + 1e-12, as DecisionTree compares them)\n";
+                rule_t[thr] = id;
+                out << "constexpr double R" << id << " = " << exact(thr) << ";\n";
+            }
+        }
+        out << "\ninline int predict_rules(const double* x, const int* c) {\n"
+            << "    (void)x; (void)c;\n";
+        bool open_ended = true;
+        for (const auto& r : *rules) {
+            if (r.conds.empty()) {
+                // matches everything: later rules and the default are unreachable
+                out << "    return " << e.class_id[r.predicted_class] << ";\n";
+                open_ended = false;
+                break;
+            }
+            out << "    if (";
+            for (size_t i = 0; i < r.conds.size(); ++i) {
+                const auto& c = r.conds[i];
+                if (i) out << " && ";
+                if (c.is_cont) {
+                    out << "x[" << e.attr_id[c.attr_index] << "] " << (c.leq ? "<=" : ">") << " R"
+                        << rule_t[c.threshold + EPS];
+                } else {
+                    const int code = spec.attrs[c.attr_index].value_code(c.eq_value);
+                    if (code < 0) out << "false";
+                    else out << "c[" << e.attr_id[c.attr_index] << "] == " << e.value_id[c.attr_index][code];
+                }
+            }
+            out << ") return " << e.class_id[r.predicted_class] << ";\n";
+        }
+        if (open_ended) {
+            out << "    return ";
+            if (rules_default_class >= 0 && (size_t)rules_default_class < e.class_id.size()) {
+                out << e.class_id[rules_default_class];
+            } else {
+                out << rules_default_class;
+            }
+            out << ";\n";
+        }
+        out << "}\n";
+    }
+    out << "\n} // namespace " << ns << "\n";
+}
@@ -0,0 +1,151 @@
+#include "CompiledRules.h"
+#include "Stats.h"
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+// same tolerance DecisionTree applies to continuous rule conditions
+static const double EPS = 1e-12;
+
+// rows per block: every condition's bitset for one block stays cache resident
+static const size_t BLOCK_WORDS = 64;
+static const size_t BLOCK_ROWS = BLOCK_WORDS * 64;
+
+#if defined(__GNUC__)
+#define DTREE_POPCOUNT(w) __builtin_popcountll(w)
+#define DTREE_CTZ(w) __builtin_ctzll(w)
+#else
+static int dtree_popcount(std::uint64_t w) { int c = 0; while (w) { w &= w - 1; ++c; } return c; }
+static int dtree_ctz(std::uint64_t w) { int c = 0; while (!(w & 1)) { w >>= 1; ++c; } return c; }
+#define DTREE_POPCOUNT(w) dtree_popcount(w)
+#define DTREE_CTZ(w) dtree_ctz(w)
+#endif
+
+CompiledRules::CompiledRules(const DatasetSpec& spec, const std::vector<DecisionTree::Rule>& rules,
+                             int default_class)
+    : default_class_(default_class) {
+    // rules read off one tree share their path prefixes, so most conditions repeat
+    std::map<std::tuple<int, bool, bool, double, int>, int> index;
+    rule_cond_begin_.push_back(0);
+    for (const auto& r : rules) {
+        for (const auto& c : r.conds) {
+            Cond k;
+            k.attr = c.attr_index;
+            k.is_cont = c.is_cont;
+            if (c.is_cont) {
+                k.leq = c.leq;
+                k.threshold = c.threshold + EPS;
+            } else {
+                k.code = spec.attrs[c.attr_index].value_code(c.eq_value);
+            }
+            auto key = std::make_tuple(k.attr, k.is_cont, k.leq, k.threshold, k.code);
+            auto it = index.find(key);
+            if (it == index.end()) {
+                it = index.insert({key, (int)conds_.size()}).first;
+                conds_.push_back(k);
+            }
+            rule_conds_.push_back(it->second);
+        }
+        rule_cond_begin_.push_back((int)rule_conds_.size());
+        rule_class_.push_back(r.predicted_class);
+    }
+}
+
+// Row bits of condition c for the (up to 64) rows starting at base; rows past n_rows stay clear.
+CompiledRules::Word CompiledRules::condition_word(const Dataset& ds, const Cond& c, size_t base,
+                                                  size_t n_rows) const {
+    const size_t m = std::min<size_t>(64, n_rows - base);
+    Word word = 0;
+    if (!c.is_cont) {
+        const int* x = ds.code[c.attr].data() + base;
+        for (size_t j=0;j<m;++j) word |= (Word)(x[j] == c.code) << j;
+    } else if (c.leq) {
+        const double* x = ds.num[c.attr].data() + base;
+        for (size_t j=0;j<m;++j) word |= (Word)(x[j] <= c.threshold) << j;
+    } else {
+        const double* x = ds.num[c.attr].data() + base;
+        for (size_t j=0;j<m;++j) word |= (Word)(x[j] > c.threshold) << j;
+    }
+    return word;
+}
+
+// Calls visit(rule, row0 + 64*w, bits) for every word of rows first matched by `rule`, and
+// visit(n_rules(), ...) for rows no rule matches.
+template <class Visit>
+void CompiledRules::first_match(const Dataset& ds, Visit visit) const {
+    const size_t n_rows = ds.size();
+    const size_t R = rule_class_.size();
+    // bits[c*BLOCK_WORDS + w] is condition c over word w of the current block, filled on first
+    // use: once a rule's AND runs dry the rest of its conditions are never computed there,
+    // which skips most deep-path conditions of large rule sets.
+    std::vector<Word> bits(conds_.size() * BLOCK_WORDS);
+    std::vector<Word> filled(conds_.size()); // bit w set once bits[c*BLOCK_WORDS + w] is valid
+    Word free_rows[BLOCK_WORDS];
+    for (size_t row0=0; row0<n_rows; row0+=BLOCK_ROWS) {
+        const size_t n = std::min(BLOCK_ROWS, n_rows - row0);
+        const size_t words = (n + 63) / 64;
+        std::fill(filled.begin(), filled.end(), 0);
+        for (size_t w=0; w<words; ++w) {
+            const size_t m = std::min<size_t>(64, n - w * 64);
+            free_rows[w] = m == 64 ? ~(Word)0 : (((Word)1 << m) - 1);
+        }
+        size_t live = words; // free_rows[0 .. live) holds every unclaimed row
+        for (size_t r=0; r<R && live > 0; ++r) {
+            const int* cb = rule_conds_.data() + rule_cond_begin_[r];
+            const int* ce = rule_conds_.data() + rule_cond_begin_[r + 1];
+            for (size_t w=0; w<live; ++w) {
+                Word m = free_rows[w];
+                for (const int* c=cb; c!=ce && m; ++c) {
+                    Word& cw = bits[(size_t)*c * BLOCK_WORDS + w];
+                    if (!(filled[*c] >> w & 1)) {
+                        cw = condition_word(ds, conds_[*c], row0 + w * 64, n_rows);
+                        filled[*c] |= (Word)1 << w;
+                    }
+                    m &= cw;
+                }
+                if (!m) continue;
+                free_rows[w] &= ~m;
+                visit(r, row0 + w * 64, m);
+            }
+            while (live > 0 && free_rows[live - 1] == 0) --live;
+        }
+        for (size_t w=0; w<live; ++w) {
+            if (free_rows[w]) visit(R, row0 + w * 64, free_rows[w]);
+        }
+    }
+}
+
+void CompiledRules::match_batch(const Dataset& ds, int* out) const {
+    first_match(ds, [&](size_t rule, size_t base, Word m) {
+        for (; m; m &= m - 1) out[base + DTREE_CTZ(m)] = (int)rule;
+    });
+}
+
+void CompiledRules::predict_batch(const Dataset& ds, int* out) const {
+    DTREE_STAT_PHASE(PHASE_PREDICT);
+    DTREE_STAT_ADD(ROWS_PREDICTED_RULES, ds.size());
+    first_match(ds, [&](size_t rule, size_t base, Word m) {
+        const int cls = rule < rule_class_.size() ? rule_class_[rule] : default_class_;
+        for (; m; m &= m - 1) out[base + DTREE_CTZ(m)] = cls;
+    });
+}
+
+AccuracyReport CompiledRules::evaluate(const Dataset& ds) const {
+    DTREE_STAT_PHASE(PHASE_PREDICT);
+    DTREE_STAT_ADD(ROWS_PREDICTED_RULES, ds.size());
+    // one label bitset per class, laid out word-for-word like the matches
+    const size_t n_classes = ds.spec.class_labels.size();
+    const size_t n_words = (ds.size() + 63) / 64;
+    std::vector<Word> label_bits(n_classes * n_words, 0);
+    for (size_t i=0;i<ds.size();++i) {
+        label_bits[(size_t)ds.y[i] * n_words + i / 64] |= (Word)1 << (i % 64);
+    }
+    AccuracyReport r;
+    r.total = (int)ds.size();
+    first_match(ds, [&](size_t rule, size_t base, Word m) {
+        const int cls = rule < rule_class_.size() ? rule_class_[rule] : default_class_;
+        if (cls < 0 || (size_t)cls >= n_classes) return;
+        r.correct += DTREE_POPCOUNT(m & label_bits[(size_t)cls * n_words + base / 64]);
+    });
+    return r;
+}
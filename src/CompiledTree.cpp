@@ -0,0 +1,215 @@
+#include "CompiledTree.h"
+#include "BinaryIO.h"
+#include "DecisionTree.h"
+#include "Stats.h"
+#include <algorithm>
+#include <deque>
+
+const int CompiledTree::LEAF;
+const int CompiledTree::DISCRETE_BASE;
+
+#if defined(__GNUC__)
+#define DTREE_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define DTREE_PREFETCH(p) ((void)(p))
+#endif
+
+// rows advanced through the tree together by predict_batch
+static const size_t BATCH_BLOCK = 64;
+
+CompiledTree::CompiledTree(const DecisionTree& tree) : default_class_(tree.default_class()) {
+    const TreeNode* root = tree.root();
+    if (!root) return;
+    const DatasetSpec& spec = tree.spec();
+
+    // breadth-first, so siblings are allocated next to each other
+    std::deque<std::pair<const TreeNode*, int>> queue;
+    nodes_.push_back(Node());
+    queue.push_back({root, 0});
+    auto alloc = [&](const TreeNode* src) {
+        const int at = (int)nodes_.size();
+        nodes_.push_back(Node());
+        queue.push_back({src, at});
+        return at;
+    };
+    while (!queue.empty()) {
+        const TreeNode* src = queue.front().first;
+        const int at = queue.front().second;
+        queue.pop_front();
+
+        Node n;
+        if (src->is_leaf) {
+            n.attr = LEAF;
+            n.child = src->predicted_class;
+        } else if (src->is_continuous_split) {
+            n.attr = src->attr_index;
+            n.threshold = src->threshold;
+            n.child = alloc(src->left);
+            alloc(src->right);
+        } else {
+            n.attr = DISCRETE_BASE - src->attr_index;
+            n.child = (int)child_table_.size();
+            has_discrete_ = true;
+            const auto& values = spec.attrs[src->attr_index].values;
+            child_table_.resize(child_table_.size() + values.size(), -1);
+            int fallback = -1;
+            for (size_t v=0; v<values.size(); ++v) {
+                if (const TreeNode* child = src->child((int)v)) {
+                    child_table_[n.child + v] = alloc(child);
+                    continue;
+                }
+                // unseen value: back off to this node's majority class
+                if (fallback < 0) {
+                    fallback = (int)nodes_.size();
+                    Node leaf;
+                    leaf.child = src->predicted_class;
+                    nodes_.push_back(leaf);
+                }
+                child_table_[n.child + v] = fallback;
+            }
+        }
+        nodes_[at] = n;
+    }
+    index_columns();
+}
+
+// the continuous columns predict_batch prefetches, and whether any discrete node exists
+void CompiledTree::index_columns() {
+    used_num_cols_.clear();
+    has_discrete_ = false;
+    for (const Node& n : nodes_) {
+        if (n.attr >= 0) used_num_cols_.push_back(n.attr);
+        else if (n.attr <= DISCRETE_BASE) has_discrete_ = true;
+    }
+    std::sort(used_num_cols_.begin(), used_num_cols_.end());
+    used_num_cols_.erase(std::unique(used_num_cols_.begin(), used_num_cols_.end()), used_num_cols_.end());
+}
+
+static_assert(sizeof(CompiledTree::Node) == 16, "model files store nodes as f64 threshold, i32 attr, i32 child");
+
+// i32 default class, u32 #nodes, u32 #table entries, padding, nodes, table (padded)
+void CompiledTree::write(std::string& out) const {
+    binio::put(out, (int32_t)default_class_);
+    binio::put(out, (uint32_t)nodes_.size());
+    binio::put(out, (uint32_t)child_table_.size());
+    binio::pad(out);
+    for (const Node& n : nodes_) {
+        binio::put(out, n.threshold);
+        binio::put(out, (int32_t)n.attr);
+        binio::put(out, (int32_t)n.child);
+    }
+    for (int c : child_table_) binio::put(out, (int32_t)c);
+    binio::pad(out);
+}
+
+CompiledTree CompiledTree::read(binio::Reader& rd, const DatasetSpec& spec) {
+    const char* base = rd.p;
+    CompiledTree t;
+    t.default_class_ = rd.get<int32_t>();
+    const size_t n_nodes = rd.get<uint32_t>();
+    const size_t n_table = rd.get<uint32_t>();
+    rd.align(base);
+    t.nodes_.resize(rd.count(n_nodes, sizeof(Node)));
+    t.child_table_.resize(rd.count(n_table, sizeof(int)));
+    std::memcpy(t.nodes_.data(), rd.take(n_nodes * sizeof(Node)), n_nodes * sizeof(Node));
+    std::memcpy(t.child_table_.data(), rd.take(n_table * sizeof(int)), n_table * sizeof(int));
+    rd.align(base);
+
+    // breadth-first layout: every child comes after its parent, which rules out cycles
+    const int n_classes = (int)spec.class_labels.size();
+    if (t.default_class_ < -1 || t.default_class_ >= n_classes) rd.fail();
+    for (size_t i=0;i<n_nodes;++i) {
+        const Node& n = t.nodes_[i];
+        if (n.attr == LEAF) {
+            if (n.child < 0 || n.child >= n_classes) rd.fail();
+        } else if (n.attr >= 0) {
+            if ((size_t)n.attr >= spec.attrs.size() || !spec.attrs[n.attr].is_continuous) rd.fail();
+            if (n.child <= (int)i || (size_t)n.child + 1 >= n_nodes) rd.fail();
+        } else {
+            const size_t a = (size_t)(DISCRETE_BASE - n.attr);
+            if (a >= spec.attrs.size() || spec.attrs[a].is_continuous) rd.fail();
+            if (n.child < 0 || (size_t)n.child + spec.attrs[a].values.size() > n_table) rd.fail();
+            for (size_t v=0; v<spec.attrs[a].values.size(); ++v) {
+                const int c = t.child_table_[n.child + v];
+                if (c <= (int)i || (size_t)c >= n_nodes) rd.fail();
+            }
+        }
+    }
+    t.index_columns();
+    return t;
+}
+
+void CompiledTree::step_discrete(const int* const* code_cols, size_t row0, size_t n, int* cur,
+                                 bool& moved) const {
+    for (size_t j=0;j<n;++j) {
+        const Node& node = nodes_[cur[j]];
+        if (node.attr > DISCRETE_BASE) continue;
+        cur[j] = child_table_[node.child + code_cols[DISCRETE_BASE - node.attr][row0 + j]];
+        moved = true;
+    }
+}
+
+// Advances rows [row0, row0+n) one level per pass until none moves; cur holds node indices.
+// The rows' steps within a pass are independent, so their loads overlap instead of each
+// row waiting on its own node -> column -> value chain as predict_one does.
+void CompiledTree::predict_block(const double* const* num_cols, const int* const* code_cols,
+                                 size_t row0, size_t n, int* cur) const {
+    const Node* nodes = nodes_.data();
+    bool moved = true;
+    while (moved) {
+        moved = false;
+        for (size_t j=0;j<n;++j) {
+            const Node& node = nodes[cur[j]];
+            if (node.attr < 0) continue;
+            cur[j] = node.child + (num_cols[node.attr][row0 + j] <= node.threshold ? 0 : 1);
+            moved = true;
+        }
+        if (has_discrete_) step_discrete(code_cols, row0, n, cur, moved);
+    }
+}
+
+void CompiledTree::predict_batch(const double* const* num_cols, const int* const* code_cols,
+                                 size_t n_rows, int* out) const {
+    DTREE_STAT_PHASE(PHASE_PREDICT);
+    DTREE_STAT_ADD(ROWS_PREDICTED_TREE, n_rows);
+    if (nodes_.empty()) {
+        std::fill(out, out + n_rows, default_class_);
+        return;
+    }
+    int cur[BATCH_BLOCK];
+    for (size_t row0=0; row0<n_rows; row0+=BATCH_BLOCK) {
+        const size_t n = std::min(BATCH_BLOCK, n_rows - row0);
+        // warm the next block of every tested column while this one is traversed
+        if (row0 + BATCH_BLOCK < n_rows) {
+            for (int a : used_num_cols_) {
+                const double* p = num_cols[a] + row0 + BATCH_BLOCK;
+                const size_t m = std::min(BATCH_BLOCK, n_rows - row0 - BATCH_BLOCK);
+                for (size_t k=0;k<m;k+=8) DTREE_PREFETCH(p + k);
+            }
+        }
+        std::fill(cur, cur + n, 0);
+        predict_block(num_cols, code_cols, row0, n, cur);
+        for (size_t j=0;j<n;++j) out[row0 + j] = nodes_[cur[j]].child;
+    }
+}
+
+void CompiledTree::predict_batch(const Dataset& ds, int* out) const {
+    std::vector<const double*> num_cols(ds.n_attrs(), nullptr);
+    std::vector<const int*> code_cols(ds.n_attrs(), nullptr);
+    for (size_t a=0;a<ds.n_attrs();++a) {
+        if (ds.spec.attrs[a].is_continuous) num_cols[a] = ds.num[a].data();
+        else code_cols[a] = ds.code[a].data();
+    }
+    predict_batch(num_cols.data(), code_cols.data(), ds.size(), out);
+}
+
+AccuracyReport CompiledTree::evaluate(const Dataset& ds) const {
+    std::vector<int> pred(ds.size());
+    predict_batch(ds, pred.data());
+    AccuracyReport r;
+    r.total = (int)ds.size();
+    for (size_t i=0;i<ds.size();++i) {
+        if (pred[i] == ds.y[i]) r.correct += 1;
+    }
+    return r;
+}
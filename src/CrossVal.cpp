@@ -0,0 +1,106 @@
+#include "CrossVal.h"
+#include "CompiledRules.h"
+#include "Noise.h"
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+std::vector<int> assign_folds(size_t n, int folds, unsigned seed) {
+    std::vector<int> order(n);
+    for (size_t i = 0; i < n; ++i) order[i] = (int)i;
+    std::mt19937 rng(seed);
+    for (size_t i = n; i > 1; --i) std::swap(order[i - 1], order[uniform_index(rng, i)]);
+
+    std::vector<int> fold(n);
+    for (size_t k = 0; k < n; ++k) fold[order[k]] = (int)(k % (size_t)folds);
+    return fold;
+}
+
+static AccuracyReport score(const std::vector<int>& pred, const Dataset& ds) {
+    AccuracyReport r;
+    r.total = (int)ds.size();
+    for (size_t i = 0; i < ds.size(); ++i) if (pred[i] == ds.y[i]) r.correct += 1;
+    return r;
+}
+
+static AccuracySpread spread(const std::vector<FoldScores>& folds, AccuracyReport FoldScores::*which) {
+    AccuracySpread s;
+    const double n = (double)folds.size();
+    for (const FoldScores& f : folds) s.mean += (f.*which).accuracy();
+    s.mean /= n;
+    if (folds.size() > 1) {
+        for (const FoldScores& f : folds) {
+            const double d = (f.*which).accuracy() - s.mean;
+            s.variance += d * d;
+        }
+        s.variance /= n - 1.0;
+    }
+    return s;
+}
+
+CrossValResult cross_validate(const Dataset& ds, const CrossValParams& params, TaskPool* pool) {
+    const size_t n = ds.size();
+    const int K = params.folds;
+    if (K < 2 || (size_t)K > n) throw std::runtime_error("crossval: folds must be between 2 and the number of rows");
+    if (params.holdout < 0.0 || params.holdout >= 1.0) throw std::runtime_error("crossval: holdout must be in [0,1)");
+
+    const std::vector<int> fold_of = assign_folds(n, K, params.seed);
+
+    // Sorted orders over every row are valid for any subset: a fold keeps the ids of its
+    // rows. Bins are not shared, since quantiles over all rows would see the test fold.
+    DecisionTree::SortedOrders presorted;
+    const bool share_orders = params.tree.presort || params.tree.hist_bins > 0;
+    if (share_orders) presorted = DecisionTree::presort_columns(ds, pool);
+
+    CrossValResult result;
+    result.folds.resize((size_t)K);
+    TaskGroup group(pool);
+    for (int k = 0; k < K; ++k) {
+        group.run([&, k]() {
+            std::vector<int> train_rows, test_rows;
+            for (size_t i = 0; i < n; ++i) (fold_of[i] == k ? test_rows : train_rows).push_back((int)i);
+
+            std::vector<int> prune_rows;
+            if (params.holdout > 0.0) {
+                auto split = Dataset::split_holdout_rows(train_rows, params.holdout, params.seed + 999u + (unsigned)k);
+                train_rows = std::move(split.first);
+                prune_rows = std::move(split.second);
+                // ascending ids keep each node's row range in memory order
+                std::sort(train_rows.begin(), train_rows.end());
+                std::sort(prune_rows.begin(), prune_rows.end());
+            }
+
+            DecisionTree tree(params.tree);
+            if (params.tree.n_threads > 1) tree.set_pool(pool);
+            tree.fit(ds, train_rows, share_orders ? &presorted : nullptr);
+
+            // gather the test fold so the batch paths score only its rows
+            Dataset test = Dataset::empty(ds.spec);
+            test.reserve(test_rows.size());
+            for (int rid : test_rows) test.append_row(ds, (size_t)rid);
+
+            FoldScores& f = result.folds[(size_t)k];
+            std::vector<int> pred(test.size());
+            tree.predict_batch(test, pred.data());
+            f.tree = score(pred, test);
+
+            auto rules = tree.extract_rules(ds.spec);
+            CompiledRules(ds.spec, rules, tree.default_class()).predict_batch(test, pred.data());
+            f.rules = score(pred, test);
+
+            if (prune_rows.empty()) {
+                f.pruned = f.rules;
+            } else {
+                auto pruned = tree.post_prune_rules(ds, prune_rows, rules, tree.default_class());
+                CompiledRules(ds.spec, pruned, tree.default_class()).predict_batch(test, pred.data());
+                f.pruned = score(pred, test);
+            }
+        });
+    }
+    group.wait();
+
+    result.tree = spread(result.folds, &FoldScores::tree);
+    result.rules = spread(result.folds, &FoldScores::rules);
+    result.pruned = spread(result.folds, &FoldScores::pruned);
+    return result;
+}
@@ -1,8 +1,26 @@
 #include "Dataset.h"
+#include "MappedFile.h"
+#include "Stats.h"
+#include "TaskPool.h"
 #include "Util.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <memory>
 #include <stdexcept>
 #include <random>
 
+// smallest byte range a data file is split into for parallel parsing
+static const size_t LOAD_CHUNK_BYTES = size_t(1) << 20;
+
+int AttributeSpec::value_code(const std::string& v) const {
+    for (size_t i=0;i<values.size();++i) {
+        if (values[i] == v) return static_cast<int>(i);
+    }
+    return -1;
+}
+
 int DatasetSpec::class_index(const std::string& y) const {
     for (size_t i=0;i<class_labels.size();++i) {
         if (class_labels[i] == y) return static_cast<int>(i);
@@ -10,13 +28,50 @@ int DatasetSpec::class_index(const std::string& y) const {
     return -1;
 }
 
+// Advances p past the next line of [p, end) and returns it as [lb, le) with surrounding
+// whitespace trimmed; false at end of input.
+static bool next_line(const char*& p, const char* end, const char*& lb, const char*& le) {
+    if (p == end) return false;
+    const char* nl = static_cast<const char*>(std::memchr(p, '\n', (size_t)(end - p)));
+    const char* line_end = nl ? nl : end;
+    lb = p;
+    le = line_end;
+    p = nl ? nl + 1 : end;
+    while (lb < le && util::is_space(*lb)) ++lb;
+    while (le > lb && util::is_space(le[-1])) --le;
+    return true;
+}
+
+// Next whitespace-separated token [tb, te) of [p, end); false when none is left.
+static bool next_token(const char*& p, const char* end, const char*& tb, const char*& te) {
+    while (p < end && util::is_space(*p)) ++p;
+    if (p == end) return false;
+    tb = p;
+    while (p < end && !util::is_space(*p)) ++p;
+    te = p;
+    return true;
+}
+
+// index of token [b, e) in values, or -1
+static int find_token(const std::vector<std::string>& values, const char* b, const char* e) {
+    const size_t n = (size_t)(e - b);
+    for (size_t i=0;i<values.size();++i) {
+        if (values[i].size() == n && std::memcmp(values[i].data(), b, n) == 0) return static_cast<int>(i);
+    }
+    return -1;
+}
+
 DatasetSpec Dataset::load_spec(const std::string& attr_path) {
+    if (is_binary(attr_path)) return load_binary_spec(attr_path);
     DatasetSpec spec;
-    auto lines = util::read_lines(attr_path);
+    MappedFile file(attr_path);
 
     std::vector<std::vector<std::string>> toks;
-    for (auto& line : lines) {
-        auto t = util::split_ws(line);
+    const char* p = file.begin();
+    const char *lb, *le, *tb, *te;
+    while (next_line(p, file.end(), lb, le)) {
+        std::vector<std::string> t;
+        while (next_token(lb, le, tb, te)) t.push_back(std::string(tb, te));
         if (t.empty()) continue;
         toks.push_back(t);
     }
@@ -55,41 +110,215 @@ DatasetSpec Dataset::load_spec(const std::string& attr_path) {
     return spec;
 }
 
-Dataset Dataset::load_data(const DatasetSpec& spec, const std::string& data_path) {
+Dataset Dataset::empty(const DatasetSpec& spec) {
     Dataset ds;
     ds.spec = spec;
+    ds.num.resize(spec.attrs.size());
+    ds.code.resize(spec.attrs.size());
+    return ds;
+}
+
+void Dataset::reserve(size_t n) {
+    for (size_t a=0;a<spec.attrs.size();++a) {
+        if (spec.attrs[a].is_continuous) num[a].reserve(n);
+        else code[a].reserve(n);
+    }
+    y.reserve(n);
+}
+
+void Dataset::append_row(const Dataset& src, size_t r) {
+    for (size_t a=0;a<spec.attrs.size();++a) {
+        if (spec.attrs[a].is_continuous) num[a].push_back(src.num[a][r]);
+        else code[a].push_back(src.code[a][r]);
+    }
+    y.push_back(src.y[r]);
+}
+
+// number of non-blank lines in [begin, end), i.e. the rows parse_rows() will write
+static size_t count_rows(const char* begin, const char* end) {
+    size_t n = 0;
+    const char *lb, *le;
+    for (const char* p = begin; next_line(p, end, lb, le); ) {
+        if (lb != le) ++n;
+    }
+    return n;
+}
 
-    auto lines = util::read_lines(data_path);
-    for (auto& line_raw : lines) {
-        auto line = util::trim(line_raw);
-        if (line.empty()) continue;
-        auto t = util::split_ws(line);
-        if (t.size() != spec.attrs.size() + 1) {
+// Parses the lines of [begin, end) into rows row, row+1, ... of ds's (already sized)
+// columns. Each token is parsed straight into its slot; strings are only built for error
+// messages.
+static void parse_rows(const DatasetSpec& spec, const std::string& data_path,
+                       const char* begin, const char* end, Dataset& ds, size_t row) {
+    const size_t n_attrs = spec.attrs.size();
+    std::vector<double*> num(n_attrs, nullptr);
+    std::vector<int*> code(n_attrs, nullptr);
+    for (size_t a=0;a<n_attrs;++a) {
+        if (spec.attrs[a].is_continuous) num[a] = ds.num[a].mutable_data();
+        else code[a] = ds.code[a].mutable_data();
+    }
+    int* y = ds.y.mutable_data();
+
+    const char* p = begin;
+    const char *lb, *le, *tb, *te;
+    while (next_line(p, end, lb, le)) {
+        if (lb == le) continue;
+        // A bad value is reported only once the row's token count is known to be right,
+        // matching the order of checks on a split line.
+        size_t n_tok = 0;
+        size_t bad = n_attrs + 1;
+        const char *bad_b = nullptr, *bad_e = nullptr;
+        for (const char* q = lb; next_token(q, le, tb, te); ++n_tok) {
+            if (n_tok > n_attrs || bad <= n_attrs) continue;
+            if (n_tok == n_attrs) {
+                const int yi = find_token(spec.class_labels, tb, te);
+                if (yi < 0) { bad = n_tok; bad_b = tb; bad_e = te; continue; }
+                y[row] = yi;
+                continue;
+            }
+            const auto& attr = spec.attrs[n_tok];
+            if (attr.is_continuous) {
+                double v;
+                if (!util::parse_double(tb, te, v)) { bad = n_tok; bad_b = tb; bad_e = te; continue; }
+                num[n_tok][row] = v;
+            } else {
+                const int ci = find_token(attr.values, tb, te);
+                if (ci < 0) { bad = n_tok; bad_b = tb; bad_e = te; continue; }
+                code[n_tok][row] = ci;
+            }
+        }
+        if (n_tok != n_attrs + 1) {
             throw std::runtime_error("Row has wrong #tokens in " + data_path +
-                                     " expected " + std::to_string(spec.attrs.size()+1) +
-                                     " got " + std::to_string(t.size()) + " line: " + line);
+                                     " expected " + std::to_string(n_attrs+1) +
+                                     " got " + std::to_string(n_tok) + " line: " + std::string(lb, le));
+        }
+        if (bad < n_attrs) {
+            const std::string tok(bad_b, bad_e);
+            if (spec.attrs[bad].is_continuous) throw std::runtime_error("Expected numeric value, got: " + tok);
+            throw std::runtime_error("Unknown value '" + tok + "' for attribute " +
+                                     spec.attrs[bad].name + " in " + data_path);
+        }
+        if (bad == n_attrs) {
+            throw std::runtime_error("Unknown class label '" + std::string(bad_b, bad_e) + "' in " + data_path);
+        }
+        ++row;
+    }
+}
+
+static void resize_columns(Dataset& ds, size_t n) {
+    for (size_t a=0;a<ds.spec.attrs.size();++a) {
+        if (ds.spec.attrs[a].is_continuous) ds.num[a].resize(n);
+        else ds.code[a].resize(n);
+    }
+    ds.y.resize(n);
+}
+
+Dataset Dataset::load_data(const DatasetSpec& spec, const std::string& data_path, TaskPool* pool) {
+    DTREE_STAT_PHASE(PHASE_LOAD);
+    if (is_binary(data_path)) return load_binary(data_path, &spec);
+    Dataset ds = empty(spec);
+    MappedFile file(data_path);
+
+    const size_t n_chunks = pool ? std::min(file.size() / LOAD_CHUNK_BYTES, (size_t)pool->size() * 4) : 0;
+    if (n_chunks < 2) {
+        resize_columns(ds, count_rows(file.begin(), file.end()));
+        parse_rows(spec, data_path, file.begin(), file.end(), ds, 0);
+    } else {
+        // Newline-aligned byte ranges. Each range's rows are counted, then parsed in place at
+        // the range's offset, so rows land in file order. A range stops at its first bad row,
+        // so the error reported is the first range's: the one a sequential parse hits first.
+        std::vector<const char*> cut(1, file.begin());
+        for (size_t k=1; k<n_chunks; ++k) {
+            const char* at = std::max(cut.back(), file.begin() + file.size() / n_chunks * k);
+            const char* nl = static_cast<const char*>(std::memchr(at, '\n', (size_t)(file.end() - at)));
+            if (!nl) break;
+            cut.push_back(nl + 1);
+        }
+        cut.push_back(file.end());
+        const size_t n = cut.size() - 1;
+
+        std::vector<size_t> first_row(n + 1, 0);
+        {
+            TaskGroup group(pool);
+            for (size_t k=0; k<n; ++k) {
+                group.run([&, k]() { first_row[k + 1] = count_rows(cut[k], cut[k + 1]); });
+            }
+            group.wait();
+        }
+        for (size_t k=0; k<n; ++k) first_row[k + 1] += first_row[k];
+        resize_columns(ds, first_row[n]);
+
+        std::vector<std::exception_ptr> errors(n);
+        TaskGroup group(pool);
+        for (size_t k=0; k<n; ++k) {
+            group.run([&, k]() {
+                try { parse_rows(spec, data_path, cut[k], cut[k + 1], ds, first_row[k]); }
+                catch (...) { errors[k] = std::current_exception(); }
+            });
         }
-        Example ex;
-        ex.x.assign(t.begin(), t.begin() + static_cast<long>(spec.attrs.size()));
-        const std::string ylab = t.back();
-        const int yi = spec.class_index(ylab);
-        if (yi < 0) throw std::runtime_error("Unknown class label '" + ylab + "' in " + data_path);
-        ex.y = yi;
-        ds.rows.push_back(ex);
-    }
-    if (ds.rows.empty()) throw std::runtime_error("No data loaded from: " + data_path);
+        group.wait();
+        for (size_t k=0; k<n; ++k) {
+            if (errors[k]) std::rethrow_exception(errors[k]);
+        }
+    }
+    if (ds.y.empty()) throw std::runtime_error("No data loaded from: " + data_path);
     return ds;
 }
 
-std::pair<Dataset, Dataset> Dataset::split_holdout(double holdout_frac, unsigned seed) const {
+void Dataset::stream_data(const DatasetSpec& spec, const std::string& data_path,
+                          const std::function<void(const Dataset&)>& f, size_t batch_bytes) {
+    if (data_path != "-" && is_binary(data_path)) {
+        f(load_binary(data_path, &spec));
+        return;
+    }
+    std::FILE* in = data_path == "-" ? stdin : std::fopen(data_path.c_str(), "rb");
+    if (!in) throw std::runtime_error("Failed to open file: " + data_path);
+    std::unique_ptr<std::FILE, int(*)(std::FILE*)> closer(in == stdin ? nullptr : in, &std::fclose);
+
+    // buf holds the unparsed tail of the previous read followed by the next read; whole
+    // lines are parsed and the partial last line is carried over
+    std::vector<char> buf(std::max<size_t>(batch_bytes, 4096));
+    size_t have = 0;
+    size_t rows = 0;
+    bool eof = false;
+    while (!eof) {
+        if (have == buf.size()) buf.resize(buf.size() * 2); // a line longer than the buffer
+        const size_t got = std::fread(buf.data() + have, 1, buf.size() - have, in);
+        if (got == 0) {
+            if (std::ferror(in)) throw std::runtime_error("Failed to read: " + data_path);
+            eof = true;
+        }
+        have += got;
+        const char* begin = buf.data();
+        const char* end = begin + have;
+        if (!eof) {
+            const char* nl = begin + have;
+            while (nl > begin && nl[-1] != '\n') --nl;
+            if (nl == begin) continue; // no complete line yet
+            end = nl;
+        }
+        const size_t n = count_rows(begin, end);
+        if (n > 0) {
+            Dataset batch = empty(spec);
+            {
+                DTREE_STAT_PHASE(PHASE_LOAD); // parsing only, not f
+                resize_columns(batch, n);
+                parse_rows(spec, data_path, begin, end, batch, 0);
+            }
+            rows += n;
+            f(batch);
+        }
+        have = (size_t)(buf.data() + have - end);
+        std::memmove(buf.data(), end, have);
+    }
+    if (rows == 0) throw std::runtime_error("No data loaded from: " + data_path);
+}
+
+std::pair<std::vector<int>, std::vector<int>> Dataset::split_holdout_rows(const std::vector<int>& rows,
+                                                                         double holdout_frac, unsigned seed) {
     if (holdout_frac <= 0.0 || holdout_frac >= 1.0) {
         throw std::runtime_error("holdout_frac must be in (0,1)");
     }
-    Dataset a; a.spec = spec;
-    Dataset b; b.spec = spec;
-
-    std::vector<size_t> idx(rows.size());
-    for (size_t i=0;i<rows.size();++i) idx[i]=i;
+    std::vector<int> idx(rows);
 
     std::mt19937 rng(seed);
 
@@ -108,18 +337,25 @@ std::pair<Dataset, Dataset> Dataset::split_holdout(double holdout_frac, unsigned
         }
     }
 
-    const size_t n_holdout = static_cast<size_t>(rows.size() * holdout_frac);
+    std::vector<int> a, b;
+    const size_t n_holdout = static_cast<size_t>(idx.size() * holdout_frac);
+    const bool fallback = n_holdout == 0 || n_holdout == idx.size();
     for (size_t k=0;k<idx.size();++k) {
-        if (k < n_holdout) b.rows.push_back(rows[idx[k]]);
-        else a.rows.push_back(rows[idx[k]]);
-    }
-    if (a.rows.empty() || b.rows.empty()) {
         // fall back: ensure at least one row each
-        b.rows.clear(); a.rows.clear();
-        for (size_t k=0;k<idx.size();++k) {
-            if (k % 5 == 0) b.rows.push_back(rows[idx[k]]);
-            else a.rows.push_back(rows[idx[k]]);
-        }
+        const bool hold = fallback ? k % 5 == 0 : k < n_holdout;
+        (hold ? b : a).push_back(idx[k]);
     }
     return {a,b};
 }
+
+std::pair<Dataset, Dataset> Dataset::split_holdout(double holdout_frac, unsigned seed) const {
+    std::vector<int> rows(size());
+    for (size_t i=0;i<size();++i) rows[i]=(int)i;
+    const auto parts = split_holdout_rows(rows, holdout_frac, seed);
+
+    Dataset a = empty(spec);
+    Dataset b = empty(spec);
+    for (int rid : parts.first) a.append_row(*this, (size_t)rid);
+    for (int rid : parts.second) b.append_row(*this, (size_t)rid);
+    return {a,b};
+}
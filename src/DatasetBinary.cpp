@@ -0,0 +1,141 @@
+#include "Dataset.h"
+#include "BinaryIO.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+// Binary dataset file (BinaryIO.h header, count = rows). Payload: the spec, then one column
+// per attribute (f64 continuous, i32 discrete) and the i32 label column, each padded to 8
+// bytes so columns can be viewed in place from a mapping.
+static const char MAGIC[8] = {'D','T','R','E','E','D','S','\0'};
+static const uint32_t VERSION = 1;
+
+static_assert(sizeof(int) == 4, "discrete and label columns are stored as 32-bit ints");
+
+static size_t column_bytes(const AttributeSpec& a, size_t n_rows) {
+    return binio::padded(n_rows * (a.is_continuous ? sizeof(double) : sizeof(int)));
+}
+
+void Dataset::save_binary(const std::string& path) const {
+    std::string spec_bytes;
+    binio::encode_spec(spec_bytes, spec);
+    binio::pad(spec_bytes);
+    const size_t n_rows = size();
+    const char zeros[8] = {0};
+
+    uint64_t payload = spec_bytes.size() + binio::padded(n_rows * sizeof(int));
+    binio::Checksum sum;
+    sum.add(spec_bytes.data(), spec_bytes.size());
+    // hashes a column as it will be written: values, then zero padding
+    auto add_column = [&](const void* data, size_t bytes) {
+        const size_t whole = bytes & ~size_t(7);
+        sum.add(data, whole);
+        if (whole != bytes) {
+            char tail[8] = {0};
+            std::memcpy(tail, static_cast<const char*>(data) + whole, bytes - whole);
+            sum.add(tail, 8);
+        }
+    };
+    for (size_t a=0;a<spec.attrs.size();++a) {
+        payload += column_bytes(spec.attrs[a], n_rows);
+        if (spec.attrs[a].is_continuous) add_column(num[a].data(), n_rows * sizeof(double));
+        else add_column(code[a].data(), n_rows * sizeof(int));
+    }
+    add_column(y.data(), n_rows * sizeof(int));
+
+    std::ofstream out(path.c_str(), std::ios::binary);
+    if (!out) throw std::runtime_error("Failed to open output file: " + path);
+    binio::write_header(out, MAGIC, VERSION, n_rows, payload, sum.value());
+    out.write(spec_bytes.data(), (std::streamsize)spec_bytes.size());
+    auto write_column = [&](const void* data, size_t bytes) {
+        out.write(static_cast<const char*>(data), (std::streamsize)bytes);
+        out.write(zeros, (std::streamsize)(binio::padded(bytes) - bytes));
+    };
+    for (size_t a=0;a<spec.attrs.size();++a) {
+        if (spec.attrs[a].is_continuous) write_column(num[a].data(), n_rows * sizeof(double));
+        else write_column(code[a].data(), n_rows * sizeof(int));
+    }
+    write_column(y.data(), n_rows * sizeof(int));
+    if (!out) throw std::runtime_error("Failed to write dataset file: " + path);
+}
+
+bool Dataset::is_binary(const std::string& path) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    char magic[8];
+    return in.read(magic, 8) && std::memcmp(magic, MAGIC, 8) == 0;
+}
+
+// Checks the header and decodes the spec; col is left at the first column. The checksum is
+// not verified here.
+static DatasetSpec read_spec(const MappedFile& file, const std::string& path, binio::Header& h,
+                             const char*& col) {
+    h = binio::read_header(file, MAGIC, VERSION, "dataset", path);
+    const char* payload = file.begin() + binio::HEADER_BYTES;
+    binio::Reader rd = {payload, file.end(), "dataset", path};
+    DatasetSpec spec = binio::decode_spec(rd);
+    rd.align(payload);
+
+    // the columns must fill the rest of the payload exactly; bound the row count by the row
+    // width first so the sizes below cannot wrap
+    size_t row_bytes = sizeof(int);
+    for (const auto& a : spec.attrs) row_bytes += a.is_continuous ? sizeof(double) : sizeof(int);
+    const size_t n_rows = rd.count(h.count, row_bytes);
+    size_t need = binio::padded(n_rows * sizeof(int));
+    for (const auto& a : spec.attrs) need += column_bytes(a, n_rows);
+    if ((size_t)(file.end() - rd.p) != need) rd.fail();
+    col = rd.p;
+    return spec;
+}
+
+DatasetSpec Dataset::load_binary_spec(const std::string& path) {
+    MappedFile file(path);
+    binio::Header h;
+    const char* col;
+    return read_spec(file, path, h, col);
+}
+
+Dataset Dataset::load_binary(const std::string& path, const DatasetSpec* expected) {
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(path);
+    binio::Header h;
+    const char* col;
+    const DatasetSpec spec = read_spec(*file, path, h, col);
+    binio::verify_checksum(*file, h, "dataset", path);
+    if (expected && !binio::same_spec(spec, *expected)) {
+        throw std::runtime_error("Dataset file " + path + " was converted with a different attr file");
+    }
+
+    // the columns are views of the mapping, which they keep alive
+    const size_t n_rows = h.count;
+    Dataset ds = empty(spec);
+    for (size_t a=0;a<spec.attrs.size();++a) {
+        if (spec.attrs[a].is_continuous) {
+            ds.num[a] = Column<double>::view(reinterpret_cast<const double*>(col), n_rows, file);
+        } else {
+            ds.code[a] = Column<int>::view(reinterpret_cast<const int*>(col), n_rows, file);
+        }
+        col += column_bytes(spec.attrs[a], n_rows);
+    }
+    ds.y = Column<int>::view(reinterpret_cast<const int*>(col), n_rows, file);
+    if (ds.y.empty()) throw std::runtime_error("No data loaded from: " + path);
+
+    // the checksum only catches accidents: codes index the per-value tables, so check them
+    // as the text loader does
+    const auto in_range = [](const Column<int>& c, size_t n_values) {
+        for (size_t r=0;r<c.size();++r) {
+            if (c[r] < 0 || (size_t)c[r] >= n_values) return false;
+        }
+        return true;
+    };
+    for (size_t a=0;a<spec.attrs.size();++a) {
+        if (!spec.attrs[a].is_continuous && !in_range(ds.code[a], spec.attrs[a].values.size())) {
+            throw std::runtime_error("Corrupt dataset file: " + path + " (value out of range for " +
+                                     spec.attrs[a].name + ")");
+        }
+    }
+    if (!in_range(ds.y, spec.class_labels.size())) {
+        throw std::runtime_error("Corrupt dataset file: " + path + " (class label out of range)");
+    }
+    return ds;
+}
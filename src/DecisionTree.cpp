@@ -1,4 +1,9 @@
 #include "DecisionTree.h"
+#include "BinaryIO.h"
+#include "CompiledRules.h"
+#include "Noise.h"
+#include "SplitCriterion.h"
+#include "Stats.h"
 #include "Util.h"
 #include <cmath>
 #include <iostream>
@@ -7,155 +12,361 @@
 
 static const double EPS = 1e-12;
 
-double DecisionTree::entropy_counts(const std::vector<int>& counts) const {
-    double sum = 0.0;
-    for (int c : counts) sum += c;
-    if (sum <= 0.0) return 0.0;
-
-    double H = 0.0;
-    for (int c : counts) {
-        if (c <= 0) continue;
-        double p = (double)c / sum;
-        H -= p * std::log(p) / std::log(2.0);
-    }
-    return H;
-}
-
-int DecisionTree::argmax_counts(const std::vector<int>& counts) const {
+int DecisionTree::argmax_counts(const int* counts, size_t K) const {
     int best_i = 0;
-    int best_v = counts.empty() ? 0 : counts[0];
-    for (size_t i=1;i<counts.size();++i) {
+    int best_v = K == 0 ? 0 : counts[0];
+    for (size_t i=1;i<K;++i) {
         if (counts[i] > best_v) { best_v = counts[i]; best_i = (int)i; }
     }
     return best_i;
 }
 
-std::vector<int> DecisionTree::class_counts_for(const Dataset& ds, const std::vector<int>& rows) const {
-    std::vector<int> counts(ds.spec.class_labels.size(), 0);
-    for (int rid : rows) counts[ds.rows[rid].y] += 1;
-    return counts;
+static void subtract_histograms(std::vector<std::vector<int>>& parent,
+                                const std::vector<std::vector<int>>& child) {
+    for (size_t a=0;a<parent.size();++a) {
+        for (size_t i=0;i<child[a].size();++i) parent[a][i] -= child[a][i];
+    }
 }
 
-DecisionTree::BestSplit DecisionTree::choose_best_split(const Dataset& ds, const std::vector<int>& rows,
-                                                        const std::vector<int>& avail_attrs) const {
-    BestSplit best;
-    const auto parent_counts = class_counts_for(ds, rows);
-    const double parent_H = entropy_counts(parent_counts);
-    const double parent_n = (double)rows.size();
-
-    for (int aidx : avail_attrs) {
-        const auto& attr = ds.spec.attrs[aidx];
-
-        if (!attr.is_continuous) {
-            // multiway split by discrete value
-            std::unordered_map<std::string, std::vector<int>> parts;
-            parts.reserve(attr.values.size() + 2);
-            for (int rid : rows) {
-                const std::string& v = ds.rows[rid].x[aidx];
-                parts[v].push_back(rid);
-            }
-            // information gain
-            double child_H = 0.0;
-            for (auto& kv : parts) {
-                const auto& part_rows = kv.second;
-                const auto cc = class_counts_for(ds, part_rows);
-                const double w = (double)part_rows.size() / parent_n;
-                child_H += w * entropy_counts(cc);
-            }
+void DecisionTree::class_counts_for(const Dataset& ds, RowRange rows, int* counts) const {
+    std::fill(counts, counts + ds.spec.class_labels.size(), 0);
+    for (int rid : rows) counts[ds.y[rid]] += 1;
+}
 
-            const double gain = parent_H - child_H;
-            const int branches = (int)parts.size(); // if I want simplest attribute on tie
-            const int best_branches = best.is_cont ? 2 : (int)best.parts_disc.size(); // if I want simplest attribute on tie
-            if (gain > best.gain + EPS ||
-                (std::fabs(gain - best.gain) <= EPS && branches < best_branches) || // if I want simplest attribute on tie
-                (std::fabs(gain - best.gain) <= EPS && branches == best_branches && aidx < best.attr)) { // if I want simplest attribute on tie
-                best.gain = gain;
-                best.attr = aidx;
-                best.is_cont = false;
-                best.parts_disc = std::move(parts);
-                best.left_rows.clear();
-                best.right_rows.clear();
-            }
-        } else {
-            // continuous: choose threshold that maximizes gain (binary split)
-            std::vector<std::pair<double,int>> vals; // (x, rid)
-            vals.reserve(rows.size());
-            for (int rid : rows) {
-                const std::string& s = ds.rows[rid].x[aidx];
-                const double x = util::to_double(s);
-                vals.push_back({x, rid});
-            }
-            std::sort(vals.begin(), vals.end(),
-                      [](const std::pair<double,int>& p1, const std::pair<double,int>& p2){ return p1.first < p2.first; });
-            if (vals.size() < 2) continue;
-
-            // precompute prefix class counts
-            const int K = (int)ds.spec.class_labels.size();
-            std::vector<std::vector<int>> prefix(vals.size()+1, std::vector<int>(K,0));
-            for (size_t i=0;i<vals.size();++i) {
-                prefix[i+1] = prefix[i];
-                prefix[i+1][ ds.rows[vals[i].second].y ] += 1;
-            }
-            const auto total = prefix.back();
+// Split-search buffers, kept per thread and reused by every node scored on that thread, so
+// scoring a node allocates only when a buffer has to grow.
+struct SplitScratch {
+    std::vector<int> counts, sizes;       // discrete: class counts per value, rows per value
+    std::vector<int> left, synced, dirty; // continuous: left-side class counts, see eval_attr_k
+    std::vector<std::pair<double,int>> vals;
+    std::vector<int> order;               // unsorted mode: the node's rows in value order
+    std::vector<int> tmp;                 // partitioning
+    std::vector<size_t> pos;
+};
+
+static SplitScratch& split_scratch() {
+    static thread_local SplitScratch s;
+    return s;
+}
+
+// Stable k-way partition of [first, last) in place by route[row id], through scratch;
+// child c's rows land at first + starts[c].
+static void stable_partition(int* first, int* last, const std::vector<size_t>& starts, const int* route,
+                             SplitScratch& s) {
+    const size_t n = (size_t)(last - first);
+    s.tmp.resize(n);
+    s.pos.assign(starts.begin(), starts.end() - 1);
+    for (int* p = first; p != last; ++p) s.tmp[s.pos[route[*p]]++] = *p;
+    std::copy(s.tmp.begin(), s.tmp.begin() + (long)n, first);
+}
+
+// splitmix64 finalizer: seeds of child nodes from their parent's
+static uint64_t mix_seed(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static uint64_t child_seed(uint64_t parent, size_t child) {
+    return mix_seed(parent ^ (0x632BE59BD9B4E019ULL * (uint64_t)(child + 1)));
+}
+
+// C4.5 gain ratio; an attribute that does not divide the rows scores nothing
+static double gain_ratio(double gain, double split_info) {
+    return split_info > EPS ? gain / split_info : 0.0;
+}
+
+// Class updates folded into a side's running term sum before it is recomputed from the
+// counts, which bounds the rounding drift of long entropy scans.
+static const int RESYNC_UPDATES = 1024;
+
+DecisionTree::AttrCandidate DecisionTree::eval_attr(const Dataset& ds, RowRange rows, int aidx,
+                                                    const int* parent_counts, const NodeAux& aux) const {
+    DTREE_STAT_PHASE(PHASE_EVAL_ATTR);
+    // gain ratio places thresholds by information gain, so it shares the entropy kernel
+    if (params_.criterion == SplitCriterion::Gini) {
+        return eval_attr_k<criterion::Gini>(ds, rows, aidx, parent_counts, aux);
+    }
+    return eval_attr_k<criterion::Entropy>(ds, rows, aidx, parent_counts, aux);
+}
+
+template <class Kernel>
+DecisionTree::AttrCandidate DecisionTree::eval_attr_k(const Dataset& ds, RowRange rows, int aidx,
+                                                      const int* parent_counts, const NodeAux& aux) const {
+    using criterion::sum_terms;
+    AttrCandidate cand;
+    cand.attr = aidx;
+    const auto& attr = ds.spec.attrs[aidx];
+    const int K = (int)ds.spec.class_labels.size();
+    const long n = (long)rows.size();
+    const double parent_n = (double)n;
+    const double parent_imp = Kernel::weighted(n, sum_terms<Kernel>(parent_counts, K)) / parent_n;
+    const bool ratio = params_.criterion == SplitCriterion::GainRatio;
+    SplitScratch& scratch = split_scratch();
 
-            double best_gain_a = -1e9;
-            double best_thr = 0.0;
-            size_t best_cut = 0;
+    if (!attr.is_continuous) {
+        // multiway split by discrete value code: class counts per value
+        const Column<int>& col = ds.code[aidx];
+        const size_t V = attr.values.size();
+        std::vector<int>& counts = scratch.counts;
+        std::vector<int>& sizes = scratch.sizes;
+        counts.assign(V * (size_t)K, 0);
+        sizes.assign(V, 0);
+        for (int rid : rows) {
+            counts[(size_t)col[rid]*K + (size_t)ds.y[rid]] += 1;
+            sizes[col[rid]] += 1;
+        }
+        // children's impurity, weighted by size
+        double child_w = 0.0;
+        double parts_nlog2n = 0.0;
+        int branches = 0; // if I want simplest attribute on tie
+        for (size_t v=0; v<V; ++v) {
+            if (sizes[v] == 0) continue;
+            child_w += Kernel::weighted(sizes[v], sum_terms<Kernel>(&counts[v*K], K));
+            parts_nlog2n += criterion::nlog2n(sizes[v]);
+            ++branches;
+        }
+        cand.valid = true;
+        cand.is_cont = false;
+        cand.gain = parent_imp - child_w / parent_n;
+        if (ratio) cand.gain = gain_ratio(cand.gain, criterion::split_info(n, parts_nlog2n));
+        cand.branches = branches;
+        return cand;
+    }
+
+    // Continuous: cuts are scanned left to right, moving rows from the right side to the
+    // left. Each side keeps a running term sum; at a candidate cut only the classes that
+    // moved since the previous candidate are folded in, so runs of tied values cost one
+    // update per class.
+    std::vector<int>& left_counts = scratch.left;
+    std::vector<int>& synced = scratch.synced; // left counts as of the last sum update
+    std::vector<int>& dirty = scratch.dirty;   // classes moved since then
+    left_counts.assign(K, 0);
+    synced.assign(K, 0);
+    dirty.clear();
+    double sum_left = 0.0;
+    double sum_right = sum_terms<Kernel>(parent_counts, K);
+    int updates = 0;
+    auto move = [&](int k, int m) {
+        if (left_counts[k] == synced[k]) dirty.push_back(k);
+        left_counts[k] += m;
+    };
+    auto cut_gain = [&](long nL) {
+        DTREE_STAT_ADD(CANDIDATE_THRESHOLDS, 1);
+        for (int k : dirty) {
+            const int l0 = synced[k], l = left_counts[k];
+            sum_left += Kernel::term(l) - Kernel::term(l0);
+            sum_right += Kernel::term(parent_counts[k] - l) - Kernel::term(parent_counts[k] - l0);
+            synced[k] = l;
+        }
+        updates += (int)dirty.size();
+        dirty.clear();
+        if (updates >= RESYNC_UPDATES) {
+            sum_left = sum_right = 0.0;
+            for (int k=0;k<K;++k) {
+                sum_left += Kernel::term(left_counts[k]);
+                sum_right += Kernel::term(parent_counts[k] - left_counts[k]);
+            }
+            updates = 0;
+        }
+        return parent_imp - (Kernel::weighted(nL, sum_left) + Kernel::weighted(n - nL, sum_right)) / parent_n;
+    };
 
-            for (size_t i=0;i+1<vals.size();++i) {
-                const double x1 = vals[i].first;
-                const double x2 = vals[i+1].first;
-                if (std::fabs(x2 - x1) < EPS) continue; // no midpoint
-                const double thr = 0.5*(x1+x2);
+    double best_gain_a = -1e9;
+    double best_thr = 0.0;
+    long best_nL = 0;
 
-                std::vector<int> left_counts = prefix[i+1];
-                std::vector<int> right_counts(K,0);
-                for (int k=0;k<K;++k) right_counts[k] = total[k] - left_counts[k];
+    if (aux.hist) {
+        // continuous, histogram mode: scan the node's class histogram bin by bin
+        const std::vector<int>& h = (*aux.hist)[aidx];
+        const std::vector<double>& lo = aux.bins->lo[aidx];
+        const std::vector<double>& hi = aux.bins->hi[aidx];
+        const int n_bins = (int)lo.size();
+        long nL_rows = 0;
+        int best_bin = -1; // last bin on the left of the best cut
+        int prev = -1;     // last non-empty bin seen so far
 
-                const double nL = (double)(i+1);
-                const double nR = (double)(vals.size()-(i+1));
-                const double child_H = (nL/parent_n)*entropy_counts(left_counts) + (nR/parent_n)*entropy_counts(right_counts);
-                const double gain = parent_H - child_H;
+        for (int b=0;b<n_bins;++b) {
+            const int* hb = &h[(size_t)b*K];
+            int bin_n = 0;
+            for (int k=0;k<K;++k) bin_n += hb[k];
+            if (bin_n == 0) continue;
 
+            // candidate cut between the previous non-empty bin and this one
+            if (prev >= 0 && !(std::fabs(lo[b] - hi[prev]) < EPS)) {
+                const double gain = cut_gain(nL_rows);
                 if (gain > best_gain_a + EPS) {
                     best_gain_a = gain;
-                    best_thr = thr;
-                    best_cut = i+1;
+                    best_thr = 0.5*(hi[prev] + lo[b]);
+                    best_bin = prev;
+                    best_nL = nL_rows;
                 }
             }
+            for (int k=0;k<K;++k) {
+                if (hb[k]) move(k, hb[k]);
+            }
+            nL_rows += bin_n;
+            prev = b;
+        }
+        if (best_bin < 0) return cand;
+        cand.cut_bin = best_bin;
+    } else {
+        // continuous: choose threshold that maximizes gain (binary split)
+        const Column<double>& col = ds.num[aidx];
+        const SortedOrders* sorted = aux.sorted;
+        const int* order = nullptr;
+        const size_t n_order = rows.size();
+        if (sorted) {
+            // presorted mode: this node's order was kept sorted by stable partitioning, no sort here
+            order = (*sorted)[aidx].data() + (rows.first - aux.row_base);
+        } else {
+            std::vector<std::pair<double,int>>& vals = scratch.vals; // (x, rid)
+            vals.clear();
+            for (int rid : rows) vals.push_back({col[rid], rid});
+            std::sort(vals.begin(), vals.end(),
+                      [](const std::pair<double,int>& p1, const std::pair<double,int>& p2){ return p1.first < p2.first; });
+            scratch.order.clear();
+            for (auto& v : vals) scratch.order.push_back(v.second);
+            order = scratch.order.data();
+        }
+        if (n_order < 2) return cand;
 
-            const int branches = 2;
-            const int best_branches = best.is_cont ? 2 : (int)best.parts_disc.size();
-
-            if (best_gain_a > best.gain + EPS ||
-                (std::fabs(best_gain_a - best.gain) <= EPS && branches < best_branches) ||
-                (std::fabs(best_gain_a - best.gain) <= EPS && branches == best_branches && aidx < best.attr)) {
-                best.gain = best_gain_a;
-                best.attr = aidx;
-                best.is_cont = true;
-                best.threshold = best_thr;
-                best.parts_disc.clear();
-                best.left_rows.clear();
-                best.right_rows.clear();
-                for (size_t i=0;i<vals.size();++i) {
-                    if (i < best_cut) best.left_rows.push_back(vals[i].second);
-                    else best.right_rows.push_back(vals[i].second);
-                }
+        // scan cut points left to right, moving one row at a time into the left counts
+        for (size_t i=0;i+1<n_order;++i) {
+            move(ds.y[order[i]], 1);
+
+            const double x1 = col[order[i]];
+            const double x2 = col[order[i+1]];
+            if (std::fabs(x2 - x1) < EPS) continue; // no midpoint
+            const double thr = 0.5*(x1+x2);
+
+            const double gain = cut_gain((long)(i+1));
+            if (gain > best_gain_a + EPS) {
+                best_gain_a = gain;
+                best_thr = thr;
+                best_nL = (long)(i+1);
             }
         }
     }
+    cand.valid = true;
+    cand.is_cont = true;
+    cand.gain = best_gain_a;
+    if (ratio) {
+        const double parts = criterion::nlog2n(best_nL) + criterion::nlog2n(n - best_nL);
+        cand.gain = gain_ratio(best_gain_a, criterion::split_info(n, parts));
+    }
+    cand.threshold = best_thr;
+    cand.branches = 2;
+    return cand;
+}
+
+DecisionTree::BestSplit DecisionTree::choose_best_split(const Dataset& ds, RowRange rows,
+                                                        const int* parent_counts,
+                                                        const std::vector<int>& avail_attrs,
+                                                        const NodeAux& aux, double* runner_up) const {
+    DTREE_STAT_PHASE(PHASE_CHOOSE_SPLIT);
+    // Random subsampling: score a random max_features of the attributes, kept in
+    // avail_attrs order so ties still resolve by attribute index.
+    const std::vector<int>* attrs = &avail_attrs;
+    std::vector<int> sampled;
+    if (aux.max_features > 0 && (size_t)aux.max_features < avail_attrs.size()) {
+        std::mt19937 rng((uint32_t)(aux.node_seed ^ (aux.node_seed >> 32)));
+        std::vector<size_t> idx(avail_attrs.size());
+        for (size_t i=0;i<idx.size();++i) idx[i] = i;
+        for (size_t i=0;i<(size_t)aux.max_features;++i) {
+            std::swap(idx[i], idx[i + uniform_index(rng, idx.size() - i)]);
+        }
+        idx.resize((size_t)aux.max_features);
+        std::sort(idx.begin(), idx.end());
+        for (size_t i : idx) sampled.push_back(avail_attrs[i]);
+        attrs = &sampled;
+    }
+
+    // Attributes are scored independently, concurrently on wide enough nodes of a parallel fit.
+    std::vector<AttrCandidate> cands(attrs->size());
+    TaskGroup group(aux.pool);
+    for (size_t i=0;i<attrs->size();++i) {
+        auto eval = [&, i]() { cands[i] = eval_attr(ds, rows, (*attrs)[i], parent_counts, aux); };
+        if (attrs->size() > 1 && spawn_child(aux, rows.size())) group.run(eval);
+        else eval();
+    }
+    group.wait();
+
+    // Reduce in avail_attrs order so ties resolve exactly as in a serial scan: higher gain,
+    // then fewer branches, then lower attribute index.
+    BestSplit best;
+    for (const AttrCandidate& c : cands) {
+        if (!c.valid) continue;
+        const int best_branches = best.branches; // if I want simplest attribute on tie
+        if (c.gain > best.gain + EPS ||
+            (std::fabs(c.gain - best.gain) <= EPS && c.branches < best_branches) || // if I want simplest attribute on tie
+            (std::fabs(c.gain - best.gain) <= EPS && c.branches == best_branches && c.attr < best.attr)) { // if I want simplest attribute on tie
+            best.gain = c.gain;
+            best.attr = c.attr;
+            best.is_cont = c.is_cont;
+            best.branches = c.branches;
+            best.threshold = c.threshold;
+            best.cut_bin = c.cut_bin;
+        }
+    }
+    if (runner_up) {
+        *runner_up = -1e9;
+        for (const AttrCandidate& c : cands) {
+            if (c.valid && c.attr != best.attr) *runner_up = std::max(*runner_up, c.gain);
+        }
+    }
     return best;
 }
 
-std::unique_ptr<TreeNode> DecisionTree::build(const Dataset& ds, const std::vector<int>& rows,
-                                              const std::vector<int>& avail_attrs, int depth) {
-    auto node = std::unique_ptr<TreeNode>(new TreeNode());
-    node->class_counts = class_counts_for(ds, rows);
-    node->predicted_class = argmax_counts(node->class_counts);
+std::vector<size_t> DecisionTree::partition_rows(const Dataset& ds, RowRange rows, const BestSplit& split,
+                                                 const NodeAux& aux) const {
+    DTREE_STAT_PHASE(PHASE_PARTITION);
+    int* route = aux.route;
+    size_t n_children = 2;
+    if (!split.is_cont) {
+        const Column<int>& col = ds.code[split.attr];
+        n_children = ds.spec.attrs[split.attr].values.size();
+        for (int rid : rows) route[rid] = col[rid];
+    } else if (aux.hist) {
+        const std::vector<uint16_t>& bin = aux.bins->bin[split.attr];
+        for (int rid : rows) route[rid] = (int)bin[rid] <= split.cut_bin ? 0 : 1;
+    } else {
+        const Column<double>& col = ds.num[split.attr];
+        for (int rid : rows) route[rid] = col[rid] <= split.threshold ? 0 : 1;
+    }
+    std::vector<size_t> starts(n_children + 1, 0);
+    for (int rid : rows) starts[route[rid] + 1] += 1;
+    for (size_t c=0; c<n_children; ++c) starts[c+1] += starts[c];
+
+    SplitScratch& scratch = split_scratch();
+    stable_partition(rows.first, rows.last, starts, route, scratch);
+    if (aux.sorted) {
+        // each order holds the node's rows at the same offsets, so they split the same way
+        const size_t offset = (size_t)(rows.first - aux.row_base);
+        for (std::vector<int>& order : *aux.sorted) {
+            if (order.empty()) continue;
+            int* first = order.data() + offset;
+            stable_partition(first, first + rows.size(), starts, route, scratch);
+        }
+    }
+    return starts;
+}
+TreeNode* DecisionTree::build(const Dataset& ds, RowRange rows,
+                              const std::vector<int>& avail_attrs, int depth,
+                              const NodeAux& aux) {
+    const size_t K = ds.spec.class_labels.size();
+    DTREE_STAT_NODE(depth);
+    TreeNode* node = arena_->make<TreeNode>();
+    int* counts = arena_->make_array<int>(K);
+    class_counts_for(ds, rows, counts);
+    node->n_classes = (int)K;
+    node->class_counts = counts;
+    node->predicted_class = argmax_counts(counts, K);
 
     // stopping criteria
     const int majority = node->predicted_class;
-    const int maj_count = node->class_counts[majority];
+    const int maj_count = counts[majority];
     if ((int)rows.size() < params_.min_samples_split ||
         depth >= params_.max_depth ||
         avail_attrs.empty() ||
@@ -164,8 +375,11 @@ std::unique_ptr<TreeNode> DecisionTree::build(const Dataset& ds, const std::vect
         return node;
     }
 
-    BestSplit split = choose_best_split(ds, rows, avail_attrs);
+    double runner_up = 0.0;
+    BestSplit split = choose_best_split(ds, rows, counts, avail_attrs, aux, &runner_up);
+    node->checked_rows = (int)rows.size();
     if (split.attr < 0 || split.gain <= EPS) {
+        node->alt_impurity = impurity(counts, K) - std::max(split.gain, 0.0);
         node->is_leaf = true;
         return node;
     }
@@ -173,6 +387,7 @@ std::unique_ptr<TreeNode> DecisionTree::build(const Dataset& ds, const std::vect
     node->attr_index = split.attr;
     node->is_continuous_split = split.is_cont;
     node->threshold = split.threshold;
+    node->alt_impurity = impurity(counts, K) - std::max(runner_up, 0.0);
 
     // next avail attrs: for discrete, you can reuse attrs if you want (C4.5 style), but assignment doesn't require.
     // We'll allow reusing continuous attrs as well; for discrete, remove to avoid cycles.
@@ -183,76 +398,638 @@ std::unique_ptr<TreeNode> DecisionTree::build(const Dataset& ds, const std::vect
         next_avail.push_back(a);
     }
 
+    const std::vector<size_t> starts = partition_rows(ds, rows, split, aux);
+    const size_t n_parts = starts.size() - 1;
+    std::vector<RowRange> parts(n_parts);
+    for (size_t v=0; v<n_parts; ++v) {
+        parts[v].first = rows.first + starts[v];
+        parts[v].last = rows.first + starts[v+1];
+    }
+
     if (!split.is_cont) {
-        for (auto& kv : split.parts_disc) {
-            const std::string& val = kv.first;
-            auto& part_rows = kv.second;
-            node->child_by_value[val] = build(ds, part_rows, next_avail, depth+1);
+        std::vector<NodeAux> child_aux(n_parts, aux);
+        std::vector<Histograms> child_hist;
+        if (aux.hist) {
+            // histogram every part but the largest; the largest gets parent minus the others
+            size_t largest = 0;
+            for (size_t v=1; v<n_parts; ++v) {
+                if (parts[v].size() > parts[largest].size()) largest = v;
+            }
+            child_hist.resize(n_parts);
+            for (size_t v=0; v<n_parts; ++v) {
+                if (v == largest || parts[v].empty()) continue;
+                fill_histograms(ds, parts[v], *aux.bins, child_hist[v]);
+                subtract_histograms(*aux.hist, child_hist[v]);
+                child_aux[v].hist = &child_hist[v];
+            }
+            child_aux[largest].hist = aux.hist;
+        }
+        for (size_t v=0; v<n_parts; ++v) child_aux[v].node_seed = child_seed(aux.node_seed, v);
+        // every child writes its own slot of the table
+        TreeNode** children = arena_->make_array<TreeNode*>(n_parts);
+        TaskGroup group(aux.pool);
+        for (size_t v=0; v<n_parts; ++v) {
+            if (parts[v].empty()) continue;
+            auto build_child = [&, v]() { children[v] = build(ds, parts[v], next_avail, depth+1, child_aux[v]); };
+            if (spawn_child(aux, parts[v].size())) group.run(build_child);
+            else build_child();
         }
+        group.wait();
+        node->n_children = (int)n_parts;
+        node->children = children;
         node->is_leaf = false;
     } else {
-        if (split.left_rows.empty() || split.right_rows.empty()) {
+        const RowRange left = parts[0], right = parts[1];
+        if (left.empty() || right.empty()) {
             node->is_leaf = true;
             return node;
         }
-        node->left = build(ds, split.left_rows, next_avail, depth+1);
-        node->right = build(ds, split.right_rows, next_avail, depth+1);
+        NodeAux left_aux = aux, right_aux = aux;
+        left_aux.node_seed = child_seed(aux.node_seed, 0);
+        right_aux.node_seed = child_seed(aux.node_seed, 1);
+        Histograms small_hist;
+        if (aux.hist) {
+            // histogram the smaller child; the larger one is parent minus sibling
+            const bool left_small = left.size() <= right.size();
+            fill_histograms(ds, left_small ? left : right, *aux.bins, small_hist);
+            subtract_histograms(*aux.hist, small_hist);
+            (left_small ? left_aux : right_aux).hist = &small_hist;
+            (left_small ? right_aux : left_aux).hist = aux.hist;
+        }
+        TaskGroup group(aux.pool);
+        auto build_left = [&]() { node->left = build(ds, left, next_avail, depth+1, left_aux); };
+        if (spawn_child(aux, left.size())) group.run(build_left);
+        else build_left();
+        node->right = build(ds, right, next_avail, depth+1, right_aux);
+        group.wait();
         node->is_leaf = false;
     }
     return node;
 }
 
+bool DecisionTree::spawn_child(const NodeAux& aux, size_t child_rows) const {
+    // Subtrees below the row threshold are not worth a task and run inline. Subtrees only
+    // read shared state and write their own node, so the tree matches the serial build.
+    return aux.pool && child_rows >= (size_t)params_.parallel_min_rows;
+}
+
+DecisionTree::Binning DecisionTree::make_bins(const Dataset& ds, RowRange rows,
+                                              const SortedOrders* sorted) const {
+    if (params_.hist_bins > 65536) throw std::runtime_error("hist_bins must be at most 65536");
+    const size_t max_bins = (size_t)params_.hist_bins;
+    Binning b;
+    b.bin.resize(ds.spec.attrs.size());
+    b.lo.resize(ds.spec.attrs.size());
+    b.hi.resize(ds.spec.attrs.size());
+    for (size_t a=0;a<ds.spec.attrs.size();++a) {
+        if (!ds.spec.attrs[a].is_continuous || rows.empty()) continue;
+        const Column<double>& col = ds.num[a];
+        std::vector<double> vals;
+        vals.reserve(rows.size());
+        if (sorted) {
+            for (int rid : (*sorted)[a]) vals.push_back(col[rid]);
+        } else {
+            for (int rid : rows) vals.push_back(col[rid]);
+            std::sort(vals.begin(), vals.end());
+        }
+
+        size_t distinct = 1;
+        for (size_t i=1;i<vals.size();++i) if (vals[i] != vals[i-1]) ++distinct;
+
+        // Close a bin at a value boundary once it reaches the next quantile; with no more
+        // distinct values than bins, every distinct value gets its own bin.
+        std::vector<double>& lo = b.lo[a];
+        std::vector<double>& hi = b.hi[a];
+        const double n = (double)vals.size();
+        lo.push_back(vals[0]);
+        for (size_t i=0;i<vals.size();++i) {
+            const bool run_end = (i+1 == vals.size()) || vals[i+1] != vals[i];
+            if (!run_end || i+1 == vals.size()) continue;
+            const bool close = distinct <= max_bins ||
+                               (double)(i+1) >= (double)lo.size() * n / (double)max_bins;
+            if (close) {
+                hi.push_back(vals[i]);
+                lo.push_back(vals[i+1]);
+            }
+        }
+        hi.push_back(vals.back());
+
+        std::vector<uint16_t>& bin = b.bin[a];
+        bin.assign(ds.size(), 0);
+        for (int rid : rows) {
+            bin[rid] = (uint16_t)(std::lower_bound(hi.begin(), hi.end(), col[rid]) - hi.begin());
+        }
+    }
+    return b;
+}
+
+void DecisionTree::fill_histograms(const Dataset& ds, RowRange rows, const Binning& bins,
+                                   Histograms& out) const {
+    const size_t K = ds.spec.class_labels.size();
+    out.assign(bins.bin.size(), std::vector<int>());
+    for (size_t a=0;a<bins.bin.size();++a) {
+        if (bins.bin[a].empty()) continue;
+        const std::vector<uint16_t>& bin = bins.bin[a];
+        std::vector<int>& h = out[a];
+        h.assign(bins.lo[a].size() * K, 0);
+        for (int rid : rows) h[(size_t)bin[rid]*K + (size_t)ds.y[rid]] += 1;
+    }
+}
+
 void DecisionTree::fit(const Dataset& train) {
+    std::vector<int> rows(train.size());
+    for (size_t i=0;i<train.size();++i) rows[i] = (int)i;
+    fit(train, rows);
+}
+
+void DecisionTree::fit(const Dataset& train, const std::vector<int>& rows) {
+    fit(train, rows, nullptr);
+}
+
+DecisionTree::SortedOrders DecisionTree::presort_columns(const Dataset& ds, TaskPool* pool) {
+    SortedOrders sorted(ds.spec.attrs.size());
+    TaskGroup group(pool);
+    for (size_t a=0;a<ds.spec.attrs.size();++a) {
+        if (!ds.spec.attrs[a].is_continuous) continue;
+        group.run([&ds, &sorted, a]() {
+            const Column<double>& col = ds.num[a];
+            std::vector<int>& order = sorted[a];
+            order.resize(ds.size());
+            for (size_t i=0;i<ds.size();++i) order[i] = (int)i;
+            std::stable_sort(order.begin(), order.end(),
+                             [&col](int r1, int r2){ return col[r1] < col[r2]; });
+        });
+    }
+    group.wait();
+    return sorted;
+}
+
+// Each column's order of a row multiset, taken from the orders of every row: ids in value
+// order, each repeated as often as it occurs in rows. Matches sorting ascending rows stably.
+static DecisionTree::SortedOrders select_orders(const Dataset& ds, const std::vector<int>& rows,
+                                                const DecisionTree::SortedOrders& presorted) {
+    if (presorted.size() != ds.spec.attrs.size()) {
+        throw std::runtime_error("fit: presorted orders do not match the dataset");
+    }
+    std::vector<int> mult(ds.size(), 0);
+    for (int rid : rows) mult[rid] += 1;
+    DecisionTree::SortedOrders sorted(presorted.size());
+    for (size_t a=0;a<presorted.size();++a) {
+        if (!ds.spec.attrs[a].is_continuous) continue;
+        if (presorted[a].size() != ds.size()) {
+            throw std::runtime_error("fit: presorted orders do not match the dataset");
+        }
+        std::vector<int>& order = sorted[a];
+        order.reserve(rows.size());
+        for (int rid : presorted[a]) {
+            for (int m = mult[rid]; m > 0; --m) order.push_back(rid);
+        }
+    }
+    return sorted;
+}
+
+#ifdef DTREE_STATS
+static size_t sorted_bytes(const DecisionTree::SortedOrders& sorted) {
+    size_t n = 0;
+    for (const std::vector<int>& order : sorted) n += order.size() * sizeof(int);
+    return n;
+}
+#endif
+
+void DecisionTree::fit(const Dataset& train, const std::vector<int>& rows,
+                       const SortedOrders* presorted) {
+    DTREE_STAT_PHASE(PHASE_FIT);
+    std::unique_ptr<TaskPool> local_pool;
+    TaskPool* pool = pool_;
+    if (!pool && params_.n_threads > 1) {
+        local_pool.reset(new TaskPool(params_.n_threads));
+        pool = local_pool.get();
+    }
+
+    spec_ = train.spec;
+    inc_.reset();
+    if (params_.incremental && (params_.hist_bins > 0 || params_.max_features != 0)) {
+        throw std::runtime_error("fit: incremental trees need exact split finding (no bins or feature subsampling)");
+    }
+
+    for (int rid : rows) {
+        if (rid < 0 || (size_t)rid >= train.size()) throw std::runtime_error("fit: row id out of range");
+    }
+
+    // the one row-index buffer of the fit; every node owns a range of it
+    std::vector<int> row_buf(rows);
+    std::vector<int> route(train.size());
+    DTREE_STAT_ADD(FIT_BUFFER_BYTES, (row_buf.size() + route.size()) * sizeof(int));
+    RowRange all_rows;
+    all_rows.first = row_buf.data();
+    all_rows.last = row_buf.data() + row_buf.size();
+
     // compute default class from training distribution
-    std::vector<int> all_rows(train.rows.size());
-    for (size_t i=0;i<train.rows.size();++i) all_rows[i] = (int)i;
-    auto counts = class_counts_for(train, all_rows);
-    default_class_ = argmax_counts(counts);
+    std::vector<int> counts(train.spec.class_labels.size());
+    class_counts_for(train, all_rows, counts.data());
+    default_class_ = argmax_counts(counts.data(), counts.size());
+
+    // the previous tree, if any, is released with its arena
+    root_ = nullptr;
+    arena_.reset(new Arena());
 
     std::vector<int> avail_attrs;
     avail_attrs.reserve(train.spec.attrs.size());
     for (size_t i=0;i<train.spec.attrs.size();++i) avail_attrs.push_back((int)i);
 
-    root_ = build(train, all_rows, avail_attrs, 0);
+    NodeAux aux;
+    aux.pool = pool;
+    aux.row_base = row_buf.data();
+    aux.route = route.data();
+    aux.node_seed = mix_seed(params_.seed);
+    aux.max_features = params_.max_features;
+    if (aux.max_features < 0) {
+        aux.max_features = std::max(1, (int)std::lround(std::sqrt((double)train.spec.attrs.size())));
+    }
+    if (params_.hist_bins > 0) {
+        // quantize once; the root's histograms are filled directly, every other node's come
+        // from its parent (directly for smaller children, by subtraction for the largest)
+        SortedOrders sorted;
+        if (presorted) sorted = select_orders(train, row_buf, *presorted);
+        const Binning bins = make_bins(train, all_rows, presorted ? &sorted : nullptr);
+        DTREE_STAT_ADD(FIT_BUFFER_BYTES, sorted_bytes(sorted) + bins.bin_bytes());
+        Histograms hist;
+        fill_histograms(train, all_rows, bins, hist);
+        aux.bins = &bins;
+        aux.hist = &hist;
+        root_ = build(train, all_rows, avail_attrs, 0, aux);
+    } else if (params_.presort) {
+        // sort every continuous column once; build() keeps the orders sorted by stable partitioning
+        SortedOrders sorted;
+        if (presorted) {
+            sorted = select_orders(train, row_buf, *presorted);
+        } else {
+            sorted.resize(train.spec.attrs.size());
+            for (size_t a=0;a<train.spec.attrs.size();++a) {
+                if (!train.spec.attrs[a].is_continuous) continue;
+                const Column<double>& col = train.num[a];
+                sorted[a] = row_buf;
+                std::stable_sort(sorted[a].begin(), sorted[a].end(),
+                                 [&col](int r1, int r2){ return col[r1] < col[r2]; });
+            }
+        }
+        DTREE_STAT_ADD(FIT_BUFFER_BYTES, sorted_bytes(sorted));
+        aux.sorted = &sorted;
+        root_ = build(train, all_rows, avail_attrs, 0, aux);
+    } else {
+        root_ = build(train, all_rows, avail_attrs, 0, aux);
+    }
+    compiled_ = CompiledTree(*this);
+
+    if (params_.incremental) {
+        // keep the fitted rows, in fit order, and which leaf each one reached
+        inc_.reset(new Incremental());
+        bool all_rows_in_order = rows.size() == train.size();
+        for (size_t i=0;i<rows.size() && all_rows_in_order;++i) all_rows_in_order = rows[i] == (int)i;
+        if (all_rows_in_order) {
+            inc_->rows = train;
+        } else {
+            inc_->rows = Dataset::empty(train.spec);
+            inc_->rows.reserve(rows.size());
+            for (int rid : rows) inc_->rows.append_row(train, (size_t)rid);
+        }
+        std::vector<int> ids(rows.size());
+        for (size_t i=0;i<ids.size();++i) ids[i] = (int)i;
+        inc_->route.resize(ids.size());
+        if (root_) index_leaves(root_, ids);
+    }
+}
+
+
+DecisionTree DecisionTree::truncated(int max_depth, int min_samples_split) const {
+    if (max_depth > params_.max_depth || min_samples_split < params_.min_samples_split) {
+        throw std::runtime_error("truncated: limits must be at least as tight as the fitted tree's");
+    }
+    TreeParams p = params_;
+    p.max_depth = max_depth;
+    p.min_samples_split = min_samples_split;
+    DecisionTree t(p);
+    t.pool_ = pool_;
+    t.spec_ = spec_;
+    t.default_class_ = default_class_;
+    t.arena_.reset(new Arena());
+    if (root_) t.root_ = t.copy_truncated(root_, 0);
+    t.compiled_ = CompiledTree(t);
+    return t;
+}
+
+TreeNode* DecisionTree::copy_truncated(const TreeNode* src, int depth) {
+    TreeNode* node = arena_->make<TreeNode>();
+    int* counts = arena_->make_array<int>((size_t)src->n_classes);
+    std::copy(src->class_counts, src->class_counts + src->n_classes, counts);
+    node->n_classes = src->n_classes;
+    node->class_counts = counts;
+    node->predicted_class = src->predicted_class;
+
+    // the same stopping tests as build(); the node's row count is the sum of its counts
+    int n_rows = 0;
+    for (int k=0;k<src->n_classes;++k) n_rows += counts[k];
+    if (src->is_leaf || n_rows < params_.min_samples_split || depth >= params_.max_depth) {
+        node->is_leaf = true;
+        return node;
+    }
+
+    node->attr_index = src->attr_index;
+    node->is_continuous_split = src->is_continuous_split;
+    node->threshold = src->threshold;
+    node->alt_impurity = src->alt_impurity;
+    node->checked_rows = src->checked_rows;
+    if (src->is_continuous_split) {
+        node->left = copy_truncated(src->left, depth+1);
+        node->right = copy_truncated(src->right, depth+1);
+    } else {
+        node->n_children = src->n_children;
+        node->children = arena_->make_array<TreeNode*>((size_t)src->n_children);
+        for (int v=0; v<src->n_children; ++v) {
+            if (src->children[v]) node->children[v] = copy_truncated(src->children[v], depth+1);
+        }
+    }
+    return node;
+}
+
+UpdateReport DecisionTree::update(const Dataset& new_rows) {
+    DTREE_STAT_PHASE(PHASE_FIT);
+    if (!inc_ || !root_) throw std::runtime_error("update: the tree was not fitted with TreeParams::incremental");
+    // value codes index child tables sized by the fitted spec, so the dictionaries must match
+    if (!binio::same_spec(new_rows.spec, spec_)) {
+        throw std::runtime_error("update: rows were not loaded with the fitted dataset's attr file");
+    }
+    const size_t K = spec_.class_labels.size();
+    Dataset& hist = inc_->rows;
+    UpdateReport report;
+    report.rows = new_rows.size();
+
+    // route each row to its leaf, counting it at every node on the way
+    std::unordered_set<const TreeNode*> touched;
+    for (size_t r=0;r<new_rows.size();++r) {
+        const int rid = (int)hist.size();
+        hist.append_row(new_rows, r);
+        const int y = hist.y[rid];
+        TreeNode* node = root_;
+        while (true) {
+            node->class_counts[y] += 1;
+            touched.insert(node);
+            if (node->is_leaf) break;
+            const int a = node->attr_index;
+            if (node->is_continuous_split) {
+                node = hist.num[a][rid] <= node->threshold ? node->left : node->right;
+                continue;
+            }
+            TreeNode*& child = node->children[hist.code[a][rid]];
+            if (!child) {
+                // first row with this value here: an empty leaf for refresh() to settle
+                child = arena_->make<TreeNode>();
+                child->n_classes = (int)K;
+                child->class_counts = arena_->make_array<int>(K);
+                child->is_leaf = true;
+            }
+            node = child;
+        }
+        inc_->leaf_rows[node].push_back(rid);
+    }
+    inc_->route.resize(hist.size());
+
+    std::vector<int> avail_attrs;
+    for (size_t i=0;i<spec_.attrs.size();++i) avail_attrs.push_back((int)i);
+    root_ = refresh(root_, avail_attrs, 0, touched, report);
+    default_class_ = argmax_counts(root_->class_counts, K);
+    compiled_ = CompiledTree(*this);
+    return report;
+}
+
+double DecisionTree::impurity(const int* counts, size_t K) const {
+    if (params_.criterion == SplitCriterion::Gini) return criterion::impurity<criterion::Gini>(counts, K);
+    return criterion::impurity<criterion::Entropy>(counts, K);
+}
+
+// Whether a split other than node's own may now score at least as well, after rows were
+// added since it was last scored. Let P be the rows seen then, a fraction 1 - l of the rows
+// P' seen now. Impurity left by a split is concave in the rows' distribution, so on P' any
+// other split leaves at least (1 - l) * alt_impurity, and its gain is at most
+// impurity(P') - (1 - l) * alt_impurity. The node's own split (same threshold) is scored
+// exactly from its children's counts. For a leaf the question is whether any split may now
+// gain anything. Gain ratio has no such bound and is always re-checked. Other thresholds of
+// a continuous split's own attribute are not covered; refresh() rescans that attribute.
+bool DecisionTree::split_may_change(const TreeNode* node, int n_rows) const {
+    const size_t K = (size_t)node->n_classes;
+    if (n_rows == node->checked_rows) return false;
+    if (params_.criterion == SplitCriterion::GainRatio) return true;
+    const double l = (double)(n_rows - node->checked_rows) / (double)n_rows;
+    const double parent = impurity(node->class_counts, K);
+    const double best_other = parent - (1.0 - l) * node->alt_impurity;
+    if (node->is_leaf) return best_other > EPS;
+
+    double child_w = 0.0;
+    auto add_child = [&](const TreeNode* c) {
+        if (!c) return;
+        int nc = 0;
+        for (size_t k=0;k<K;++k) nc += c->class_counts[k];
+        child_w += (double)nc * impurity(c->class_counts, K);
+    };
+    if (node->is_continuous_split) {
+        add_child(node->left);
+        add_child(node->right);
+    } else {
+        for (int v=0; v<node->n_children; ++v) add_child(node->children[v]);
+    }
+    const double own = parent - child_w / (double)n_rows;
+    return own <= EPS || own <= best_other + EPS;
+}
+
+TreeNode* DecisionTree::refresh(TreeNode* node, const std::vector<int>& avail, int depth,
+                                const std::unordered_set<const TreeNode*>& touched, UpdateReport& report) {
+    if (!touched.count(node)) return node;
+    const size_t K = (size_t)node->n_classes;
+    node->predicted_class = argmax_counts(node->class_counts, K);
+    int n = 0;
+    for (size_t k=0;k<K;++k) n += node->class_counts[k];
+
+    // the same stopping tests as build()
+    if (node->is_leaf) {
+        if (n < params_.min_samples_split || depth >= params_.max_depth || avail.empty() ||
+            node->class_counts[node->predicted_class] == n || !split_may_change(node, n)) {
+            return node;
+        }
+        std::vector<int> rows;
+        collect_rows(node, rows);
+        return rebuild(node, rows, avail, depth, report);
+    }
+
+    const bool may_change = split_may_change(node, n);
+    if (may_change || (node->is_continuous_split && n != node->checked_rows)) {
+        std::vector<int> rows;
+        collect_rows(node, rows);
+        report.nodes_checked += 1;
+        report.rows_rescanned += rows.size();
+        std::vector<int> buf(rows);
+        RowRange range;
+        range.first = buf.data();
+        range.last = buf.data() + buf.size();
+        NodeAux aux;
+        aux.row_base = buf.data();
+        aux.route = inc_->route.data();
+        if (!may_change) {
+            // no other attribute can have overtaken the split, but its best threshold may
+            // have moved: rescan only its own attribute
+            const AttrCandidate own = eval_attr(inc_->rows, range, node->attr_index, node->class_counts, aux);
+            if (!own.valid || own.threshold != node->threshold) return rebuild(node, rows, avail, depth, report);
+        } else {
+            double runner_up = 0.0;
+            const BestSplit best = choose_best_split(inc_->rows, range, node->class_counts, avail, aux, &runner_up);
+            if (best.attr != node->attr_index || best.gain <= EPS ||
+                (best.is_cont && best.threshold != node->threshold)) {
+                return rebuild(node, rows, avail, depth, report);
+            }
+            node->alt_impurity = impurity(node->class_counts, K) - std::max(runner_up, 0.0);
+            node->checked_rows = n;
+        }
+    }
+
+    std::vector<int> next_avail;
+    for (int a : avail) {
+        if (a == node->attr_index && !node->is_continuous_split) continue;
+        next_avail.push_back(a);
+    }
+    if (node->is_continuous_split) {
+        node->left = refresh(node->left, next_avail, depth+1, touched, report);
+        node->right = refresh(node->right, next_avail, depth+1, touched, report);
+    } else {
+        for (int v=0; v<node->n_children; ++v) {
+            if (node->children[v]) node->children[v] = refresh(node->children[v], next_avail, depth+1, touched, report);
+        }
+    }
+    return node;
+}
+
+TreeNode* DecisionTree::rebuild(TreeNode* node, std::vector<int> rows, const std::vector<int>& avail, int depth,
+                                UpdateReport& report) {
+    report.subtrees_rebuilt += 1;
+    report.rows_rescanned += rows.size();
+    drop_leaves(node);
+    std::vector<int> buf(rows); // build() partitions it in place
+    RowRange range;
+    range.first = buf.data();
+    range.last = buf.data() + buf.size();
+    NodeAux aux;
+    aux.row_base = buf.data();
+    aux.route = inc_->route.data();
+    aux.node_seed = mix_seed(params_.seed);
+    TreeNode* fresh = build(inc_->rows, range, avail, depth, aux);
+    index_leaves(fresh, rows);
+    return fresh;
+}
+
+void DecisionTree::collect_rows(const TreeNode* node, std::vector<int>& out) const {
+    const size_t begin = out.size();
+    std::vector<const TreeNode*> stack(1, node);
+    while (!stack.empty()) {
+        const TreeNode* n = stack.back();
+        stack.pop_back();
+        if (n->is_leaf) {
+            auto it = inc_->leaf_rows.find(n);
+            if (it != inc_->leaf_rows.end()) out.insert(out.end(), it->second.begin(), it->second.end());
+        } else if (n->is_continuous_split) {
+            stack.push_back(n->left);
+            stack.push_back(n->right);
+        } else {
+            for (int v=0; v<n->n_children; ++v) {
+                if (n->children[v]) stack.push_back(n->children[v]);
+            }
+        }
+    }
+    std::sort(out.begin() + (long)begin, out.end());
+}
+
+void DecisionTree::drop_leaves(const TreeNode* node) {
+    if (node->is_leaf) {
+        inc_->leaf_rows.erase(node);
+    } else if (node->is_continuous_split) {
+        drop_leaves(node->left);
+        drop_leaves(node->right);
+    } else {
+        for (int v=0; v<node->n_children; ++v) {
+            if (node->children[v]) drop_leaves(node->children[v]);
+        }
+    }
+}
+
+// rows must be ascending and each must reach a leaf of node (true of the rows it was built on)
+void DecisionTree::index_leaves(const TreeNode* node, const std::vector<int>& rows) {
+    const Dataset& ds = inc_->rows;
+    for (int rid : rows) {
+        const TreeNode* n = node;
+        while (!n->is_leaf) {
+            const int a = n->attr_index;
+            n = n->is_continuous_split ? (ds.num[a][rid] <= n->threshold ? n->left : n->right)
+                                       : n->children[ds.code[a][rid]];
+        }
+        inc_->leaf_rows[n].push_back(rid);
+    }
 }
 
 int DecisionTree::predict_one(const DatasetSpec& spec, const Example& ex) const {
     (void)spec;
-    const TreeNode* node = root_.get();
+    DTREE_STAT_ADD(ROWS_PREDICTED_TREE, 1);
+    const TreeNode* node = root_;
     while (node && !node->is_leaf) {
         const int a = node->attr_index;
         if (!node->is_continuous_split) {
-            const std::string& v = ex.x[a];
-            auto it = node->child_by_value.find(v);
-            if (it == node->child_by_value.end()) return node->predicted_class; // unseen value fallback
-            node = it->second.get();
+            const TreeNode* child = node->child(ex.code(a));
+            if (!child) return node->predicted_class; // unseen value fallback
+            node = child;
         } else {
-            const double x = util::to_double(ex.x[a]);
-            node = (x <= node->threshold) ? node->left.get() : node->right.get();
+            const double x = ex.num(a);
+            node = (x <= node->threshold) ? node->left : node->right;
         }
     }
     if (!node) return default_class_;
     return node->predicted_class;
 }
 
+void DecisionTree::predict_batch(const Dataset& ds, int* out) const {
+    compiled_.predict_batch(ds, out);
+}
+
+void DecisionTree::predict_batch(const double* const* num_cols, const int* const* code_cols,
+                                 size_t n_rows, int* out) const {
+    compiled_.predict_batch(num_cols, code_cols, n_rows, out);
+}
+
 AccuracyReport DecisionTree::evaluate(const Dataset& ds) const {
+    std::vector<int> pred(ds.size());
+    predict_batch(ds, pred.data());
     AccuracyReport r;
-    r.total = (int)ds.rows.size();
-    for (auto& ex : ds.rows) {
-        const int yp = predict_one(ds.spec, ex);
-        if (yp == ex.y) r.correct += 1;
+    r.total = (int)ds.size();
+    for (size_t i=0;i<ds.size();++i) {
+        if (pred[i] == ds.y[i]) r.correct += 1;
     }
     return r;
 }
 
 // Replace BOTH print_tree() and print_node() with these
 
-static std::string counts_str(const std::vector<int>& cc) {
+// codes of a discrete node's children, ordered by value name
+static std::vector<int> children_by_value(const AttributeSpec& attr, const TreeNode* node) {
+    std::vector<int> keys;
+    for (int v = 0; v < node->n_children; ++v) {
+        if (node->children[v]) keys.push_back(v);
+    }
+    std::sort(keys.begin(), keys.end(),
+              [&attr](int v1, int v2){ return attr.values[v1] < attr.values[v2]; });
+    return keys;
+}
+
+static std::string counts_str(const TreeNode* node) {
     std::ostringstream oss;
     oss << "(";
-    for (size_t i = 0; i < cc.size(); ++i) {
-        oss << cc[i];
-        if (i + 1 < cc.size()) oss << ",";
+    for (int i = 0; i < node->n_classes; ++i) {
+        oss << node->class_counts[i];
+        if (i + 1 < node->n_classes) oss << ",";
     }
     oss << ")";
     return oss.str();
@@ -265,10 +1042,10 @@ void DecisionTree::print_tree(const DatasetSpec& spec) const {
     }
 
     // Print root “node label”
-    const TreeNode* r = root_.get();
+    const TreeNode* r = root_;
     if (r->is_leaf) {
         std::cout << "[LEAF] predict " << spec.class_labels[r->predicted_class]
-                  << " " << counts_str(r->class_counts) << "\n";
+                  << " " << counts_str(r) << "\n";
         return;
     }
 
@@ -290,18 +1067,15 @@ void DecisionTree::print_node(const DatasetSpec& spec, const TreeNode* node,
 
     if (!node->is_continuous_split) {
         // stable order for printing
-        std::vector<std::string> keys;
-        keys.reserve(node->child_by_value.size());
-        for (auto& kv : node->child_by_value) keys.push_back(kv.first);
-        std::sort(keys.begin(), keys.end());
+        const std::vector<int> keys = children_by_value(attr, node);
 
         for (size_t i = 0; i < keys.size(); ++i) {
             const bool last = (i + 1 == keys.size());
             const std::string branch = last ? "└── " : "├── ";
             const std::string nextIndent = indent + (last ? "    " : "│   ");
 
-            const std::string& val = keys[i];
-            const TreeNode* child = node->child_by_value.at(val).get();
+            const std::string& val = attr.values[keys[i]];
+            const TreeNode* child = node->children[keys[i]];
 
             // Print edge condition first
             std::cout << indent << branch << attr.name << " = " << val;
@@ -310,7 +1084,7 @@ void DecisionTree::print_node(const DatasetSpec& spec, const TreeNode* node,
             if (child->is_leaf) {
                 std::cout << "  =>  [LEAF] predict "
                           << spec.class_labels[child->predicted_class] << " "
-                          << counts_str(child->class_counts) << "\n";
+                          << counts_str(child) << "\n";
             } else {
                 const auto& childAttr = spec.attrs[child->attr_index];
                 std::cout << "  ->  split on " << childAttr.name;
@@ -323,8 +1097,8 @@ void DecisionTree::print_node(const DatasetSpec& spec, const TreeNode* node,
         // continuous: two branches
         struct Branch { bool leq; const TreeNode* child; };
         Branch bs[2] = {
-            { true,  node->left.get()  },
-            { false, node->right.get() }
+            { true,  node->left  },
+            { false, node->right }
         };
 
         for (int i = 0; i < 2; ++i) {
@@ -341,7 +1115,7 @@ void DecisionTree::print_node(const DatasetSpec& spec, const TreeNode* node,
             if (child->is_leaf) {
                 std::cout << "  =>  [LEAF] predict "
                           << spec.class_labels[child->predicted_class] << " "
-                          << counts_str(child->class_counts) << "\n";
+                          << counts_str(child) << "\n";
             } else {
                 const auto& childAttr = spec.attrs[child->attr_index];
                 std::cout << "  ->  split on " << childAttr.name;
@@ -359,24 +1133,20 @@ void DecisionTree::extract_rules_rec(const DatasetSpec& spec, const TreeNode* no
         Rule r;
         r.conds = path;
         r.predicted_class = node->predicted_class;
-        r.class_counts = node->class_counts;
+        r.class_counts.assign(node->class_counts, node->class_counts + node->n_classes);
         out.push_back(r);
         return;
     }
     const int a = node->attr_index;
     if (!node->is_continuous_split) {
         // stable order
-        std::vector<std::string> keys;
-        keys.reserve(node->child_by_value.size());
-        for (auto& kv : node->child_by_value) keys.push_back(kv.first);
-        std::sort(keys.begin(), keys.end());
-        for (auto& v : keys) {
+        for (int v : children_by_value(spec.attrs[a], node)) {
             Condition c;
             c.attr_index = a;
             c.is_cont = false;
-            c.eq_value = v;
+            c.eq_value = spec.attrs[a].values[v];
             path.push_back(c);
-            extract_rules_rec(spec, node->child_by_value.at(v).get(), path, out);
+            extract_rules_rec(spec, node->children[v], path, out);
             path.pop_back();
         }
     } else {
@@ -388,7 +1158,7 @@ void DecisionTree::extract_rules_rec(const DatasetSpec& spec, const TreeNode* no
             c.threshold = node->threshold;
             c.leq = true;
             path.push_back(c);
-            extract_rules_rec(spec, node->left.get(), path, out);
+            extract_rules_rec(spec, node->left, path, out);
             path.pop_back();
         }
         // right (>)
@@ -399,7 +1169,7 @@ void DecisionTree::extract_rules_rec(const DatasetSpec& spec, const TreeNode* no
             c.threshold = node->threshold;
             c.leq = false;
             path.push_back(c);
-            extract_rules_rec(spec, node->right.get(), path, out);
+            extract_rules_rec(spec, node->right, path, out);
             path.pop_back();
         }
     }
@@ -408,7 +1178,7 @@ void DecisionTree::extract_rules_rec(const DatasetSpec& spec, const TreeNode* no
 std::vector<DecisionTree::Rule> DecisionTree::extract_rules(const DatasetSpec& spec) const {
     std::vector<Rule> rules;
     std::vector<Condition> path;
-    if (root_) extract_rules_rec(spec, root_.get(), path, rules);
+    if (root_) extract_rules_rec(spec, root_, path, rules);
     return rules;
 }
 
@@ -416,9 +1186,9 @@ bool DecisionTree::rule_matches(const DatasetSpec& spec, const Example& ex, cons
     (void)spec;
     for (const auto& c : r.conds) {
         if (!c.is_cont) {
-            if (ex.x[c.attr_index] != c.eq_value) return false;
+            if (ex.value(c.attr_index) != c.eq_value) return false;
         } else {
-            const double x = util::to_double(ex.x[c.attr_index]);
+            const double x = ex.num(c.attr_index);
             if (c.leq) { if (!(x <= c.threshold + EPS)) return false; }
             else       { if (!(x >  c.threshold + EPS)) return false; }
         }
@@ -428,55 +1198,129 @@ bool DecisionTree::rule_matches(const DatasetSpec& spec, const Example& ex, cons
 
 int DecisionTree::predict_one_rules(const DatasetSpec& spec, const Example& ex,
                                     const std::vector<Rule>& rules, int default_class) const {
+    DTREE_STAT_ADD(ROWS_PREDICTED_RULES, 1);
     for (const auto& r : rules) {
         if (rule_matches(spec, ex, r)) return r.predicted_class;
     }
     return default_class;
 }
 
-AccuracyReport DecisionTree::evaluate_rules(const Dataset& ds, const std::vector<Rule>& rules, int default_class) const {
-    AccuracyReport r;
-    r.total = (int)ds.rows.size();
-    for (auto& ex : ds.rows) {
-        const int yp = predict_one_rules(ds.spec, ex, rules, default_class);
-        if (yp == ex.y) r.correct += 1;
+std::vector<int> DecisionTree::condition_codes(const DatasetSpec& spec, const Rule& r) {
+    std::vector<int> codes(r.conds.size(), -1);
+    for (size_t ci=0;ci<r.conds.size();++ci) {
+        const auto& c = r.conds[ci];
+        if (!c.is_cont) codes[ci] = spec.attrs[c.attr_index].value_code(c.eq_value);
     }
-    return r;
+    return codes;
+}
+
+bool DecisionTree::condition_matches_row(const Dataset& ds, const Condition& c, int code, int rid) {
+    if (!c.is_cont) return ds.code[c.attr_index][rid] == code;
+    const double x = ds.num[c.attr_index][rid];
+    return c.leq ? (x <= c.threshold + EPS) : (x > c.threshold + EPS);
+}
+
+void DecisionTree::predict_batch_rules(const Dataset& ds, const std::vector<Rule>& rules, int default_class,
+                                       int* out) const {
+    CompiledRules(ds.spec, rules, default_class).predict_batch(ds, out);
+}
+
+AccuracyReport DecisionTree::evaluate_rules(const Dataset& ds, const std::vector<Rule>& rules, int default_class) const {
+    return CompiledRules(ds.spec, rules, default_class).evaluate(ds);
 }
 
 std::vector<DecisionTree::Rule> DecisionTree::post_prune_rules(const Dataset& prune_set,
                                                                const std::vector<Rule>& rules,
                                                                int default_class) const {
-    // Reduced-error pruning: for each rule, attempt to remove conditions that don't reduce accuracy on prune_set.
+    std::vector<int> rows(prune_set.size());
+    for (size_t i=0;i<prune_set.size();++i) rows[i] = (int)i;
+    return post_prune_rules(prune_set, rows, rules, default_class);
+}
+
+std::vector<DecisionTree::Rule> DecisionTree::post_prune_rules(const Dataset& ds,
+                                                               const std::vector<int>& prune_rows,
+                                                               const std::vector<Rule>& rules,
+                                                               int default_class) const {
+    DTREE_STAT_PHASE(PHASE_PRUNE);
+    // Reduced-error pruning: for each rule, attempt to remove conditions that don't reduce accuracy on the prune rows.
     // Order: rules are applied in sequence; we preserve order.
+    //
+    // Instead of re-scoring a copy of the rule set per candidate, keep for every prune row the
+    // rule that currently decides it (its first match). Dropping a condition from rule ri only
+    // widens ri, so the rows that can change are those decided after ri that fail exactly that
+    // one condition of ri; they move to ri. Scores come from integer hit counts, so they are
+    // exactly what evaluate_rules() would report.
     std::vector<Rule> pruned = rules;
+    const size_t N = prune_rows.size();
+    const size_t R = pruned.size();
 
-    auto acc_of = [&](const std::vector<Rule>& rr)->double {
-        return evaluate_rules(prune_set, rr, default_class).accuracy();
+    auto pred_of = [&](int owner)->int {
+        return (size_t)owner < R ? pruned[owner].predicted_class : default_class;
     };
 
-    double base_acc = acc_of(pruned);
+    std::vector<int> owner(N); // deciding rule per prune row, R = default class
+    {
+        std::vector<int> all(ds.size());
+        CompiledRules(ds.spec, pruned, default_class).match_batch(ds, all.data());
+        for (size_t i=0;i<N;++i) {
+            const int rid = prune_rows[i];
+            if (rid < 0 || (size_t)rid >= ds.size()) throw std::runtime_error("post_prune_rules: row id out of range");
+            owner[i] = all[rid];
+        }
+    }
+    AccuracyReport base;
+    base.total = (int)N;
+    for (size_t i=0;i<N;++i) if (pred_of(owner[i]) == ds.y[prune_rows[i]]) base.correct += 1;
 
-    for (size_t ri=0; ri<pruned.size(); ++ri) {
+    std::vector<int> fail_count(N), fail_cond(N);
+    for (size_t ri=0; ri<R; ++ri) {
         bool improved_or_equal = true;
         while (improved_or_equal && !pruned[ri].conds.empty()) {
             improved_or_equal = false;
+            const Rule& rule = pruned[ri];
+            const size_t C = rule.conds.size();
+            const std::vector<int> codes = condition_codes(ds.spec, rule);
+
+            // For rows decided after ri: how many of ri's conditions they fail, and which one
+            // if exactly one. Removing that condition hands the row to ri.
+            std::vector<int> delta(C, 0);
+            for (size_t i=0;i<N;++i) {
+                fail_count[i] = 0;
+                if ((size_t)owner[i] <= ri) continue;
+                for (size_t ci=0; ci<C && fail_count[i] < 2; ++ci) {
+                    DTREE_STAT_ADD(PRUNE_CONDITION_CHECKS, 1);
+                    if (!condition_matches_row(ds, rule.conds[ci], codes[ci], prune_rows[i])) {
+                        fail_count[i] += 1;
+                        fail_cond[i] = (int)ci;
+                    }
+                }
+                if (fail_count[i] != 1) continue;
+                const int y = ds.y[prune_rows[i]];
+                delta[fail_cond[i]] += (rule.predicted_class == y ? 1 : 0) - (pred_of(owner[i]) == y ? 1 : 0);
+            }
+
             // Try removing each condition once; keep the best change (if not worse).
-            double best_acc = base_acc;
+            double best_acc = base.accuracy();
             int best_remove = -1;
+            int best_correct = base.correct;
 
-            for (size_t ci=0; ci<pruned[ri].conds.size(); ++ci) {
-                auto trial = pruned;
-                trial[ri].conds.erase(trial[ri].conds.begin() + (long)ci);
-                double a = acc_of(trial);
+            DTREE_STAT_ADD(PRUNE_TRIALS, C);
+            for (size_t ci=0; ci<C; ++ci) {
+                AccuracyReport trial = base;
+                trial.correct += delta[ci];
+                double a = trial.accuracy();
                 if (a + EPS >= best_acc) {
                     best_acc = a;
                     best_remove = (int)ci;
+                    best_correct = trial.correct;
                 }
             }
             if (best_remove >= 0) {
+                for (size_t i=0;i<N;++i) {
+                    if ((size_t)owner[i] > ri && fail_count[i] == 1 && fail_cond[i] == best_remove) owner[i] = (int)ri;
+                }
                 pruned[ri].conds.erase(pruned[ri].conds.begin() + best_remove);
-                base_acc = best_acc;
+                base.correct = best_correct;
                 improved_or_equal = true;
             }
         }
@@ -0,0 +1,117 @@
+#include "Forest.h"
+#include "Noise.h"
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+// rows voted on together: one block's votes and per-tree predictions stay in cache
+static const size_t VOTE_BLOCK = 4096;
+
+// generator of tree i's bootstrap sample; std::seed_seq is fully specified, so samples
+// are the same on every platform
+static std::mt19937 tree_rng(unsigned seed, size_t i) {
+    std::seed_seq seq{seed, (unsigned)i, 0x5eedu};
+    return std::mt19937(seq);
+}
+
+void Forest::fit(const Dataset& train) {
+    if (params_.n_trees < 1) throw std::runtime_error("Forest needs at least one tree");
+    if (params_.bootstrap && !(params_.sample_fraction > 0.0)) {
+        throw std::runtime_error("Forest sample_fraction must be positive");
+    }
+    std::unique_ptr<TaskPool> local_pool;
+    TaskPool* pool = pool_;
+    if (!pool && params_.tree.n_threads > 1) {
+        local_pool.reset(new TaskPool(params_.tree.n_threads));
+        pool = local_pool.get();
+    }
+
+    spec_ = train.spec;
+    trees_.clear();
+    trees_.reserve((size_t)params_.n_trees);
+    for (int i = 0; i < params_.n_trees; ++i) {
+        TreeParams tp = params_.tree;
+        tp.n_threads = 1;
+        tp.seed = params_.seed * 1000003u + (unsigned)i;
+        trees_.push_back(DecisionTree(tp));
+    }
+
+    const size_t n = train.size();
+    const size_t n_sample = params_.bootstrap ? std::max<size_t>(1, (size_t)(params_.sample_fraction * (double)n)) : n;
+    TaskGroup group(pool);
+    for (size_t i = 0; i < trees_.size(); ++i) {
+        group.run([&, i]() {
+            std::vector<int> rows(n_sample);
+            if (params_.bootstrap && n > 0) {
+                std::mt19937 rng = tree_rng(params_.seed, i);
+                for (size_t j = 0; j < n_sample; ++j) rows[j] = (int)uniform_index(rng, n);
+                // ascending ids keep each node's row range in memory order
+                std::sort(rows.begin(), rows.end());
+            } else {
+                for (size_t j = 0; j < n; ++j) rows[j] = (int)j;
+            }
+            trees_[i].fit(train, rows);
+        });
+    }
+    group.wait();
+}
+
+void Forest::for_blocks(size_t n, const std::function<void(size_t, size_t)>& f) const {
+    TaskGroup group(pool_);
+    for (size_t b = 0; b < n; b += VOTE_BLOCK) {
+        const size_t e = std::min(n, b + VOTE_BLOCK);
+        group.run([&f, b, e]() { f(b, e); });
+    }
+    group.wait();
+}
+
+void Forest::count_votes(const Dataset& ds, size_t begin, size_t end, int* votes) const {
+    const size_t K = spec_.class_labels.size();
+    const size_t n = end - begin;
+    std::vector<const double*> num_cols(ds.n_attrs(), nullptr);
+    std::vector<const int*> code_cols(ds.n_attrs(), nullptr);
+    for (size_t a = 0; a < ds.n_attrs(); ++a) {
+        if (ds.spec.attrs[a].is_continuous) num_cols[a] = ds.num[a].data() + begin;
+        else code_cols[a] = ds.code[a].data() + begin;
+    }
+    std::fill(votes, votes + n * K, 0);
+    std::vector<int> pred(n);
+    for (const DecisionTree& t : trees_) {
+        t.predict_batch(num_cols.data(), code_cols.data(), n, pred.data());
+        for (size_t i = 0; i < n; ++i) votes[i * K + (size_t)pred[i]] += 1;
+    }
+}
+
+void Forest::predict_batch(const Dataset& ds, int* out) const {
+    const size_t K = spec_.class_labels.size();
+    for_blocks(ds.size(), [&](size_t b, size_t e) {
+        std::vector<int> votes((e - b) * K);
+        count_votes(ds, b, e, votes.data());
+        for (size_t i = 0; i < e - b; ++i) {
+            const int* v = &votes[i * K];
+            out[b + i] = (int)(std::max_element(v, v + K) - v);
+        }
+    });
+}
+
+void Forest::predict_proba(const Dataset& ds, double* out) const {
+    const size_t K = spec_.class_labels.size();
+    const double scale = trees_.empty() ? 0.0 : 1.0 / (double)trees_.size();
+    for_blocks(ds.size(), [&](size_t b, size_t e) {
+        std::vector<int> votes((e - b) * K);
+        count_votes(ds, b, e, votes.data());
+        for (size_t i = 0; i < votes.size(); ++i) out[b * K + i] = votes[i] * scale;
+    });
+}
+
+AccuracyReport Forest::evaluate(const Dataset& ds) const {
+    std::vector<int> pred(ds.size());
+    predict_batch(ds, pred.data());
+    AccuracyReport r;
+    r.total = (int)ds.size();
+    for (size_t i = 0; i < ds.size(); ++i) {
+        if (pred[i] == ds.y[i]) r.correct += 1;
+    }
+    return r;
+}
@@ -0,0 +1,324 @@
+#include "Hoeffding.h"
+#include "DecisionTree.h"
+#include "Stats.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+
+static const double EPS = 1e-12;
+
+void SplitStats::Gauss::add(double x) {
+    if (n == 0) lo = hi = x;
+    lo = std::min(lo, x);
+    hi = std::max(hi, x);
+    n += 1;
+    const double d = x - mean;
+    mean += d / (double)n;
+    m2 += d * (x - mean);
+}
+
+double SplitStats::Gauss::n_leq(double t) const {
+    if (n == 0 || t < lo) return 0.0;
+    if (t >= hi) return (double)n;
+    const double sd = std::sqrt(m2 / (double)n);
+    if (sd < EPS) return mean <= t ? (double)n : 0.0;
+    return (double)n * 0.5 * std::erfc((mean - t) / (sd * std::sqrt(2.0)));
+}
+
+SplitStats::SplitStats(const DatasetSpec& spec, const std::vector<int>& attrs)
+    : K_((int)spec.class_labels.size()), class_counts_((size_t)K_, 0), attrs_(attrs), stats_(attrs.size()) {
+    for (size_t i = 0; i < attrs.size(); ++i) {
+        AttrStats& s = stats_[i];
+        const AttributeSpec& as = spec.attrs[attrs[i]];
+        s.attr = attrs[i];
+        s.is_cont = as.is_continuous;
+        if (s.is_cont) {
+            s.gauss.resize((size_t)K_);
+        } else {
+            s.n_values = (int)as.values.size();
+            s.counts.assign((size_t)s.n_values * K_, 0);
+        }
+    }
+}
+
+void SplitStats::add(const Dataset& ds, size_t r) {
+    const int y = ds.y[r];
+    n_ += 1;
+    class_counts_[y] += 1;
+    for (AttrStats& s : stats_) {
+        if (s.is_cont) s.gauss[y].add(ds.num[s.attr][r]);
+        else s.counts[(size_t)ds.code[s.attr][r] * K_ + y] += 1;
+    }
+}
+
+double SplitStats::impurity(SplitCriterion c, const double* counts, double n) const {
+    if (n <= 0.0) return 0.0;
+    double s = 0.0;
+    if (c == SplitCriterion::Gini) {
+        for (int k = 0; k < K_; ++k) s += counts[k] * counts[k];
+        return 1.0 - s / (n * n);
+    }
+    for (int k = 0; k < K_; ++k) {
+        if (counts[k] > 0.0) s += counts[k] * std::log2(counts[k]);
+    }
+    return std::log2(n) - s / n;
+}
+
+std::vector<SplitStats::Merit> SplitStats::merits(SplitCriterion c, int split_points) const {
+    std::vector<Merit> out;
+    if (n_ == 0) return out;
+    const double n = (double)n_;
+    std::vector<double> parent(class_counts_.begin(), class_counts_.end());
+    const double parent_imp = impurity(c, parent.data(), n);
+    std::vector<double> part((size_t)K_), right((size_t)K_);
+
+    for (const AttrStats& s : stats_) {
+        Merit m;
+        m.attr = s.attr;
+        m.is_cont = s.is_cont;
+        if (!s.is_cont) {
+            double child_w = 0.0;
+            int branches = 0;
+            for (int v = 0; v < s.n_values; ++v) {
+                double nv = 0.0;
+                for (int k = 0; k < K_; ++k) nv += (part[k] = (double)s.counts[(size_t)v*K_ + k]);
+                if (nv == 0.0) continue;
+                child_w += nv * impurity(c, part.data(), nv);
+                ++branches;
+            }
+            if (branches < 2) continue;
+            m.merit = parent_imp - child_w / n;
+            out.push_back(m);
+            continue;
+        }
+
+        double lo = 0.0, hi = 0.0;
+        bool any = false;
+        for (const Gauss& g : s.gauss) {
+            if (g.n == 0) continue;
+            lo = any ? std::min(lo, g.lo) : g.lo;
+            hi = any ? std::max(hi, g.hi) : g.hi;
+            any = true;
+        }
+        if (!any || hi - lo < EPS) continue;
+        DTREE_STAT_ADD(CANDIDATE_THRESHOLDS, split_points);
+        bool found = false;
+        for (int i = 1; i <= split_points; ++i) {
+            const double t = lo + (hi - lo) * (double)i / (double)(split_points + 1);
+            double nL = 0.0;
+            for (int k = 0; k < K_; ++k) {
+                part[k] = s.gauss[k].n_leq(t);
+                right[k] = parent[k] - part[k];
+                nL += part[k];
+            }
+            const double nR = n - nL;
+            const double merit = parent_imp - (nL * impurity(c, part.data(), nL) +
+                                               nR * impurity(c, right.data(), nR)) / n;
+            if (!found || merit > m.merit + EPS) {
+                m.merit = merit;
+                m.threshold = t;
+                found = true;
+            }
+        }
+        out.push_back(m);
+    }
+    std::stable_sort(out.begin(), out.end(),
+                     [](const Merit& a, const Merit& b){ return a.merit > b.merit + EPS; });
+    return out;
+}
+
+std::vector<int> SplitStats::child_counts(const Merit& m, int child) const {
+    std::vector<int> counts((size_t)K_, 0);
+    for (const AttrStats& s : stats_) {
+        if (s.attr != m.attr) continue;
+        for (int k = 0; k < K_; ++k) {
+            if (!s.is_cont) {
+                counts[k] = (int)s.counts[(size_t)child*K_ + k];
+            } else {
+                const double left = s.gauss[k].n_leq(m.threshold);
+                counts[k] = (int)std::lround(child == 0 ? left : (double)class_counts_[k] - left);
+            }
+        }
+    }
+    return counts;
+}
+
+double hoeffding_bound(SplitCriterion c, int n_classes, double delta, long n) {
+    // the range of the merit: log2(K) bits for information gain, 1 for Gini
+    const double range = c == SplitCriterion::Gini ? 1.0 : std::log2((double)std::max(n_classes, 2));
+    return std::sqrt(range * range * std::log(1.0 / delta) / (2.0 * (double)n));
+}
+
+// Grows one tree in an arena as rows arrive. Every node's counts are updated along the
+// row's path; only leaves keep split statistics, and a leaf's statistics are dropped when
+// it splits. Children of a split start from the counts the leaf's statistics give them.
+class HoeffdingLearner {
+public:
+    HoeffdingLearner(const DatasetSpec& spec, const HoeffdingParams& p, Arena& arena)
+        : spec_(spec), p_(p), arena_(arena), K_((int)spec.class_labels.size()) {
+        std::vector<int> attrs;
+        for (size_t a = 0; a < spec.attrs.size(); ++a) attrs.push_back((int)a);
+        root_ = new_leaf(0, std::vector<int>((size_t)K_, 0), attrs);
+    }
+
+    void learn(const Dataset& ds) {
+        for (size_t r = 0; r < ds.size(); ++r) learn_row(ds, r);
+    }
+
+    // sets every node's predicted class and drops children no row reached
+    TreeNode* finish() {
+        finish_node(root_, 0);
+        return root_;
+    }
+
+private:
+    struct Leaf {
+        int depth = 0;
+        long since_check = 0;
+        SplitStats stats;
+    };
+
+    const DatasetSpec& spec_;
+    HoeffdingParams p_;
+    Arena& arena_;
+    int K_;
+    TreeNode* root_ = nullptr;
+    std::unordered_map<const TreeNode*, Leaf> leaves_;
+
+    TreeNode* new_leaf(int depth, const std::vector<int>& counts, const std::vector<int>& attrs) {
+        DTREE_STAT_NODE(depth);
+        TreeNode* node = arena_.make<TreeNode>();
+        int* c = arena_.make_array<int>((size_t)K_);
+        std::copy(counts.begin(), counts.end(), c);
+        node->n_classes = K_;
+        node->class_counts = c;
+        node->is_leaf = true;
+        Leaf& leaf = leaves_[node];
+        leaf.depth = depth;
+        leaf.stats = SplitStats(spec_, attrs);
+        return node;
+    }
+
+    void learn_row(const Dataset& ds, size_t r) {
+        const int y = ds.y[r];
+        TreeNode* node = root_;
+        while (true) {
+            node->class_counts[y] += 1;
+            if (node->is_leaf) break;
+            const int a = node->attr_index;
+            if (node->is_continuous_split) node = ds.num[a][r] <= node->threshold ? node->left : node->right;
+            else node = node->children[ds.code[a][r]];
+        }
+        Leaf& leaf = leaves_[node];
+        leaf.stats.add(ds, r);
+        if (++leaf.since_check >= p_.grace_period) {
+            leaf.since_check = 0;
+            try_split(node, leaf);
+        }
+    }
+
+    void try_split(TreeNode* node, Leaf& leaf) {
+        DTREE_STAT_PHASE(PHASE_CHOOSE_SPLIT);
+        const long n = leaf.stats.rows();
+        if (leaf.depth >= p_.max_depth) return;
+        for (long c : leaf.stats.class_counts()) {
+            if (c == n) return; // pure since the leaf was made
+        }
+        const std::vector<SplitStats::Merit> merits = leaf.stats.merits(p_.criterion, p_.split_points);
+        if (merits.empty() || merits[0].merit <= EPS) return;
+        const double second = merits.size() > 1 ? std::max(merits[1].merit, 0.0) : 0.0;
+        const double eps = hoeffding_bound(p_.criterion, K_, p_.delta, n);
+        if (merits[0].merit - second <= eps && eps >= p_.tie_threshold) return;
+        split(node, leaf, merits[0]);
+    }
+
+    void split(TreeNode* node, Leaf& leaf, const SplitStats::Merit& m) {
+        const int depth = leaf.depth;
+        const SplitStats stats = std::move(leaf.stats);
+        leaves_.erase(node);
+
+        std::vector<int> next_attrs;
+        for (int a : stats.attrs()) {
+            if (a == m.attr && !m.is_cont) continue;
+            next_attrs.push_back(a);
+        }
+        node->is_leaf = false;
+        node->attr_index = m.attr;
+        node->is_continuous_split = m.is_cont;
+        node->threshold = m.threshold;
+        if (m.is_cont) {
+            node->left = new_leaf(depth + 1, stats.child_counts(m, 0), next_attrs);
+            node->right = new_leaf(depth + 1, stats.child_counts(m, 1), next_attrs);
+            return;
+        }
+        // a child for every value, so later rows always have a leaf to reach
+        const int V = (int)spec_.attrs[m.attr].values.size();
+        node->n_children = V;
+        node->children = arena_.make_array<TreeNode*>((size_t)V);
+        for (int v = 0; v < V; ++v) node->children[v] = new_leaf(depth + 1, stats.child_counts(m, v), next_attrs);
+    }
+
+    void finish_node(TreeNode* node, int parent_class) {
+        long total = 0;
+        for (int k = 0; k < K_; ++k) total += node->class_counts[k];
+        if (total == 0) {
+            node->predicted_class = parent_class;
+        } else {
+            int best = 0; // ties go to the lowest class index, as in fit()
+            for (int k = 1; k < K_; ++k) {
+                if (node->class_counts[k] > node->class_counts[best]) best = k;
+            }
+            node->predicted_class = best;
+        }
+        if (node->is_leaf) return;
+        if (node->is_continuous_split) {
+            finish_node(node->left, node->predicted_class);
+            finish_node(node->right, node->predicted_class);
+            return;
+        }
+        for (int v = 0; v < node->n_children; ++v) {
+            TreeNode* child = node->children[v];
+            long child_total = 0;
+            for (int k = 0; k < K_; ++k) child_total += child->class_counts[k];
+            if (child_total == 0) node->children[v] = nullptr; // as fit(): no rows, no child
+            else finish_node(child, node->predicted_class);
+        }
+    }
+};
+
+static void check_params(const HoeffdingParams& p) {
+    if (p.criterion == SplitCriterion::GainRatio) {
+        throw std::runtime_error("fit_stream: gain_ratio is not supported (use entropy or gini)");
+    }
+    if (!(p.delta > 0.0 && p.delta < 1.0)) throw std::runtime_error("fit_stream: delta must be in (0, 1)");
+    if (p.grace_period < 1) throw std::runtime_error("fit_stream: grace period must be at least 1");
+    if (p.split_points < 1) throw std::runtime_error("fit_stream: split points must be at least 1");
+}
+
+void DecisionTree::fit_stream(const DatasetSpec& spec, const std::string& data_path, const HoeffdingParams& p) {
+    fit_stream_from(spec, p, [&spec, &data_path](const std::function<void(const Dataset&)>& learn) {
+        Dataset::stream_data(spec, data_path, learn);
+    });
+}
+
+void DecisionTree::fit_stream(const Dataset& ds, const HoeffdingParams& p) {
+    fit_stream_from(ds.spec, p, [&ds](const std::function<void(const Dataset&)>& learn) { learn(ds); });
+}
+
+void DecisionTree::fit_stream_from(const DatasetSpec& spec, const HoeffdingParams& p, const StreamSource& source) {
+    DTREE_STAT_PHASE(PHASE_FIT);
+    check_params(p);
+    spec_ = spec;
+    params_.criterion = p.criterion;
+    params_.max_depth = p.max_depth;
+    root_ = nullptr;
+    inc_.reset();
+    arena_.reset(new Arena());
+
+    HoeffdingLearner learner(spec_, p, *arena_);
+    source([&learner](const Dataset& batch) { learner.learn(batch); });
+    root_ = learner.finish();
+    default_class_ = root_->predicted_class;
+    compiled_ = CompiledTree(*this);
+}
@@ -0,0 +1,45 @@
+#include "MappedFile.h"
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DTREE_HAVE_MMAP 1
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef DTREE_HAVE_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Failed to open file: " + path);
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        size_ = (size_t)st.st_size;
+        if (size_ == 0) { ::close(fd); return; }
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            ::madvise(p, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(p);
+            mapped_ = true;
+            ::close(fd);
+            return;
+        }
+    }
+    ::close(fd);
+#endif
+    // not mappable (pipe, special file, no mmap): read it instead
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in) throw std::runtime_error("Failed to open file: " + path);
+    buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+MappedFile::~MappedFile() {
+#ifdef DTREE_HAVE_MMAP
+    if (mapped_) ::munmap(const_cast<char*>(data_), size_);
+#endif
+}
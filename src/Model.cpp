@@ -0,0 +1,95 @@
+#include "Model.h"
+#include "BinaryIO.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+
+// Payload: spec, compiled tree (CompiledTree::write), u32 has_rules, i32 rules default
+// class, then `count` rules, each: i32 class, u32 #conditions, u32 #class counts, the
+// conditions (i32 attr, u32 continuous, u32 leq, f64 threshold, str value) and the i32
+// class counts. Padded to 8 bytes.
+static const char MAGIC[8] = {'D','T','R','E','E','M','D','\0'};
+static const uint32_t VERSION = 1;
+
+Model::Model(const DecisionTree& t) : spec(t.spec()), tree(t.compiled()) {}
+
+void Model::set_rules(const std::vector<DecisionTree::Rule>& r, int default_class) {
+    has_rules = true;
+    rules = r;
+    rules_default_class = default_class;
+    compiled_rules = CompiledRules(spec, rules, default_class);
+}
+
+void Model::save(const std::string& path) const {
+    std::string payload;
+    binio::encode_spec(payload, spec);
+    binio::pad(payload);
+    tree.write(payload);
+    binio::put(payload, (uint32_t)(has_rules ? 1 : 0));
+    binio::put(payload, (int32_t)rules_default_class);
+    for (const auto& r : rules) {
+        binio::put(payload, (int32_t)r.predicted_class);
+        binio::put(payload, (uint32_t)r.conds.size());
+        binio::put(payload, (uint32_t)r.class_counts.size());
+        for (const auto& c : r.conds) {
+            binio::put(payload, (int32_t)c.attr_index);
+            binio::put(payload, (uint32_t)(c.is_cont ? 1 : 0));
+            binio::put(payload, (uint32_t)(c.leq ? 1 : 0));
+            binio::put(payload, c.threshold);
+            binio::put_str(payload, c.eq_value);
+        }
+        for (int k : r.class_counts) binio::put(payload, (int32_t)k);
+    }
+    binio::pad(payload);
+
+    binio::Checksum sum;
+    sum.add(payload.data(), payload.size());
+    std::ofstream out(path.c_str(), std::ios::binary);
+    if (!out) throw std::runtime_error("Failed to open output file: " + path);
+    binio::write_header(out, MAGIC, VERSION, rules.size(), payload.size(), sum.value());
+    out.write(payload.data(), (std::streamsize)payload.size());
+    if (!out) throw std::runtime_error("Failed to write model file: " + path);
+}
+
+Model Model::load(const std::string& path) {
+    MappedFile file(path);
+    const binio::Header h = binio::read_header(file, MAGIC, VERSION, "model", path);
+    binio::verify_checksum(file, h, "model", path);
+
+    const char* payload = file.begin() + binio::HEADER_BYTES;
+    binio::Reader rd = {payload, file.end(), "model", path};
+    Model m;
+    m.spec = binio::decode_spec(rd);
+    rd.align(payload);
+    m.tree = CompiledTree::read(rd, m.spec);
+
+    const bool has_rules = rd.get<uint32_t>() != 0;
+    const int default_class = rd.get<int32_t>();
+    const int n_classes = (int)m.spec.class_labels.size();
+    // a rule takes at least 12 bytes, a condition 24, a class count 4
+    std::vector<DecisionTree::Rule> rules(rd.count(h.count, 12));
+    for (auto& r : rules) {
+        r.predicted_class = rd.get<int32_t>();
+        if (r.predicted_class < 0 || r.predicted_class >= n_classes) rd.fail();
+        const uint32_t n_conds = rd.get<uint32_t>();
+        const uint32_t n_counts = rd.get<uint32_t>();
+        r.conds.resize(rd.count(n_conds, 24));
+        r.class_counts.resize(rd.count(n_counts, 4));
+        for (auto& c : r.conds) {
+            c.attr_index = rd.get<int32_t>();
+            c.is_cont = rd.get<uint32_t>() != 0;
+            c.leq = rd.get<uint32_t>() != 0;
+            c.threshold = rd.get<double>();
+            c.eq_value = rd.str();
+            if (c.attr_index < 0 || (size_t)c.attr_index >= m.spec.attrs.size() ||
+                m.spec.attrs[c.attr_index].is_continuous != c.is_cont) rd.fail();
+        }
+        for (int& k : r.class_counts) k = rd.get<int32_t>();
+    }
+    if (has_rules) {
+        if (default_class < 0 || default_class >= n_classes) rd.fail();
+        m.set_rules(rules, default_class);
+    }
+    return m;
+}
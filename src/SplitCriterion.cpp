@@ -0,0 +1,30 @@
+#include "SplitCriterion.h"
+#include <stdexcept>
+
+namespace criterion {
+
+double nlog2n_table[NLOG2N_TABLE];
+
+static struct FillTable {
+    FillTable() {
+        nlog2n_table[0] = 0.0;
+        for (int c = 1; c < NLOG2N_TABLE; ++c) nlog2n_table[c] = (double)c * std::log2((double)c);
+    }
+} fill_table;
+
+} // namespace criterion
+
+SplitCriterion parse_split_criterion(const std::string& name) {
+    if (name == "entropy") return SplitCriterion::Entropy;
+    if (name == "gini") return SplitCriterion::Gini;
+    if (name == "gain_ratio") return SplitCriterion::GainRatio;
+    throw std::runtime_error("Unknown split criterion: " + name + " (expected entropy, gini or gain_ratio)");
+}
+
+const char* split_criterion_name(SplitCriterion c) {
+    switch (c) {
+    case SplitCriterion::Gini: return "gini";
+    case SplitCriterion::GainRatio: return "gain_ratio";
+    default: return "entropy";
+    }
+}
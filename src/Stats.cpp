@@ -0,0 +1,166 @@
+#include "Stats.h"
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace stats {
+
+static const char* const COUNTER_NAMES[N_COUNTERS] = {
+    "nodes_built", "candidate_thresholds", "numbers_parsed", "strtod_fallbacks",
+    "tree_bytes", "fit_buffer_bytes", "prune_condition_checks", "prune_trials",
+    "rows_predicted_tree", "rows_predicted_rules"
+};
+static const char* const PHASE_NAMES[N_PHASES] = {
+    "load", "fit", "choose_split", "eval_attr", "partition", "prune", "predict"
+};
+
+// plain sums of every counter
+struct Totals {
+    uint64_t counters[N_COUNTERS] = {};
+    uint64_t phase_ns[N_PHASES] = {};
+    uint64_t phase_calls[N_PHASES] = {};
+    uint64_t depth_nodes[MAX_DEPTH] = {};
+};
+
+#ifdef DTREE_STATS
+// Live threads' counters, and the sums of threads that have exited.
+struct Registry {
+    std::mutex m;
+    std::vector<ThreadStats*> live;
+    Totals retired;
+};
+static Registry& registry() {
+    static Registry* r = new Registry(); // never destroyed: threads may exit after main
+    return *r;
+}
+
+template <size_t N>
+static void fold(uint64_t (&dst)[N], std::atomic<uint64_t> (&src)[N]) {
+    for (size_t i = 0; i < N; ++i) dst[i] += src[i].load(std::memory_order_relaxed);
+}
+template <size_t N>
+static void zero(std::atomic<uint64_t> (&x)[N]) {
+    for (size_t i = 0; i < N; ++i) x[i].store(0, std::memory_order_relaxed);
+}
+
+ThreadStats::ThreadStats() {
+    zero(counters);
+    zero(phase_ns);
+    zero(phase_calls);
+    zero(depth_nodes);
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.m);
+    r.live.push_back(this);
+}
+
+ThreadStats::~ThreadStats() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.m);
+    fold(r.retired.counters, counters);
+    fold(r.retired.phase_ns, phase_ns);
+    fold(r.retired.phase_calls, phase_calls);
+    fold(r.retired.depth_nodes, depth_nodes);
+    for (size_t i = 0; i < r.live.size(); ++i) {
+        if (r.live[i] == this) { r.live.erase(r.live.begin() + (long)i); break; }
+    }
+}
+
+ThreadStats& local() {
+    static thread_local ThreadStats t;
+    return t;
+}
+
+uint64_t now_ns() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool compiled_in() { return true; }
+
+void reset() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.m);
+    r.retired = Totals();
+    for (ThreadStats* t : r.live) {
+        zero(t->counters);
+        zero(t->phase_ns);
+        zero(t->phase_calls);
+        zero(t->depth_nodes);
+    }
+}
+
+static Totals collect() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.m);
+    Totals t = r.retired;
+    for (ThreadStats* s : r.live) {
+        fold(t.counters, s->counters);
+        fold(t.phase_ns, s->phase_ns);
+        fold(t.phase_calls, s->phase_calls);
+        fold(t.depth_nodes, s->depth_nodes);
+    }
+    return t;
+}
+#else
+bool compiled_in() { return false; }
+void reset() {}
+static Totals collect() { return Totals(); }
+#endif
+
+// deepest depth with any nodes, or -1
+static int last_depth(const Totals& t) {
+    int d = -1;
+    for (int i = 0; i < MAX_DEPTH; ++i) if (t.depth_nodes[i]) d = i;
+    return d;
+}
+
+void report(std::ostream& out) {
+    if (!compiled_in()) {
+        out << "stats: not compiled in (rebuild with make clean && make STATS=1)\n";
+        return;
+    }
+    const Totals t = collect();
+    char buf[128];
+    out << "=== Stats ===\n";
+    out << "phase            calls        seconds\n";
+    for (int p = 0; p < N_PHASES; ++p) {
+        std::snprintf(buf, sizeof(buf), "%-14s %7llu %14.6f\n", PHASE_NAMES[p],
+                      (unsigned long long)t.phase_calls[p], (double)t.phase_ns[p] * 1e-9);
+        out << buf;
+    }
+    out << "counter                              value\n";
+    for (int c = 0; c < N_COUNTERS; ++c) {
+        std::snprintf(buf, sizeof(buf), "%-24s %16llu\n", COUNTER_NAMES[c], (unsigned long long)t.counters[c]);
+        out << buf;
+    }
+    const int last = last_depth(t);
+    if (last >= 0) {
+        out << "nodes per depth:";
+        for (int d = 0; d <= last; ++d) out << " " << d << ":" << t.depth_nodes[d];
+        if (last == MAX_DEPTH - 1) out << " (last includes deeper)";
+        out << "\n";
+    }
+}
+
+void report_json(std::ostream& out) {
+    const Totals t = collect();
+    out << "{\n  \"compiled_in\": " << (compiled_in() ? "true" : "false") << ",\n  \"phases\": {";
+    for (int p = 0; p < N_PHASES; ++p) {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "%.9f", (double)t.phase_ns[p] * 1e-9);
+        out << (p ? ", " : "") << "\"" << PHASE_NAMES[p] << "\": {\"calls\": " << t.phase_calls[p]
+            << ", \"seconds\": " << buf << "}";
+    }
+    out << "},\n  \"counters\": {";
+    for (int c = 0; c < N_COUNTERS; ++c) {
+        out << (c ? ", " : "") << "\"" << COUNTER_NAMES[c] << "\": " << t.counters[c];
+    }
+    out << "},\n  \"nodes_per_depth\": [";
+    const int last = last_depth(t);
+    for (int d = 0; d <= last; ++d) out << (d ? ", " : "") << t.depth_nodes[d];
+    out << "]\n}\n";
+}
+
+} // namespace stats
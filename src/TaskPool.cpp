@@ -0,0 +1,120 @@
+#include "TaskPool.h"
+
+namespace {
+// worker index of the current thread within tl_pool, or -1 outside any pool
+thread_local const TaskPool* tl_pool = nullptr;
+thread_local int tl_worker = -1;
+}
+
+TaskPool::TaskPool(int n_threads) : queued_(0), stop_(false) {
+    const int n_workers = n_threads > 1 ? n_threads - 1 : 0;
+    for (int i=0;i<n_workers;++i) queues_.push_back(std::unique_ptr<Queue>(new Queue()));
+    for (int i=0;i<n_workers;++i) workers_.push_back(std::thread(&TaskPool::worker_loop, this, i));
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lk(sleep_m_);
+        stop_ = true;
+    }
+    sleep_cv_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+void TaskPool::push(std::function<void()> task) {
+    Queue& q = (tl_pool == this) ? *queues_[tl_worker] : injector_;
+    {
+        std::lock_guard<std::mutex> lk(q.m);
+        q.tasks.push_back(std::move(task));
+    }
+    queued_.fetch_add(1);
+    std::lock_guard<std::mutex> lk(sleep_m_);
+    sleep_cv_.notify_one();
+}
+
+bool TaskPool::pop(std::function<void()>& task) {
+    const int self = (tl_pool == this) ? tl_worker : -1;
+    if (self >= 0) {
+        Queue& q = *queues_[self];
+        std::lock_guard<std::mutex> lk(q.m);
+        if (!q.tasks.empty()) {
+            task = std::move(q.tasks.back());
+            q.tasks.pop_back();
+            return true;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lk(injector_.m);
+        if (!injector_.tasks.empty()) {
+            task = std::move(injector_.tasks.front());
+            injector_.tasks.pop_front();
+            return true;
+        }
+    }
+    // steal the oldest (typically largest) task from another worker
+    const int n = (int)queues_.size();
+    for (int i=1;i<=n;++i) {
+        Queue& q = *queues_[(self + i + n) % n];
+        std::lock_guard<std::mutex> lk(q.m);
+        if (!q.tasks.empty()) {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TaskPool::try_run_one() {
+    std::function<void()> task;
+    if (!pop(task)) return false;
+    queued_.fetch_sub(1);
+    task();
+    return true;
+}
+
+void TaskPool::worker_loop(int index) {
+    tl_pool = this;
+    tl_worker = index;
+    while (true) {
+        if (try_run_one()) continue;
+        std::unique_lock<std::mutex> lk(sleep_m_);
+        sleep_cv_.wait(lk, [this]{ return stop_.load() || queued_.load() > 0; });
+        if (stop_) return;
+    }
+}
+
+TaskGroup::~TaskGroup() {
+    // never leave tasks referring to this group behind
+    while (pending_.load() > 0) {
+        if (!pool_->try_run_one()) std::this_thread::yield();
+    }
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    if (!pool_) {
+        task();
+        return;
+    }
+    pending_.fetch_add(1);
+    pool_->push([this, task]() {
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lk(err_m_);
+            if (!err_) err_ = std::current_exception();
+        }
+        pending_.fetch_sub(1);
+    });
+}
+
+void TaskGroup::wait() {
+    while (pending_.load() > 0) {
+        if (!pool_->try_run_one()) std::this_thread::yield();
+    }
+    if (err_) {
+        std::exception_ptr e = err_;
+        err_ = nullptr;
+        std::rethrow_exception(e);
+    }
+}
@@ -0,0 +1,81 @@
+#include "Tune.h"
+#include <algorithm>
+#include <stdexcept>
+
+std::vector<TunePoint> tune(const Dataset& train, const Dataset& validate, const TuneGrid& grid,
+                            TaskPool* pool) {
+    if (grid.criteria.empty() || grid.holdouts.empty() || grid.max_depths.empty() || grid.min_samples_splits.empty()) {
+        throw std::runtime_error("tune: every grid dimension needs at least one value");
+    }
+    for (double h : grid.holdouts) {
+        if (h < 0.0 || h >= 1.0) throw std::runtime_error("tune: holdout must be in [0,1)");
+    }
+    const int deepest = *std::max_element(grid.max_depths.begin(), grid.max_depths.end());
+    const int smallest = *std::min_element(grid.min_samples_splits.begin(), grid.min_samples_splits.end());
+
+    DecisionTree::SortedOrders orders;
+    const bool share_orders = grid.tree.presort || grid.tree.hist_bins > 0;
+    if (share_orders) orders = DecisionTree::presort_columns(train, pool);
+
+    // one fit per (criterion, holdout)
+    const size_t H = grid.holdouts.size();
+    const size_t n_fits = grid.criteria.size() * H;
+    std::vector<DecisionTree> fits;
+    std::vector<std::vector<int>> prune_rows(n_fits);
+    for (size_t f = 0; f < n_fits; ++f) {
+        TreeParams p = grid.tree;
+        p.criterion = grid.criteria[f / H];
+        p.max_depth = deepest;
+        p.min_samples_split = smallest;
+        fits.emplace_back(p);
+    }
+    {
+        TaskGroup group(pool);
+        for (size_t f = 0; f < n_fits; ++f) {
+            group.run([&, f]() {
+                std::vector<int> rows(train.size());
+                for (size_t i = 0; i < train.size(); ++i) rows[i] = (int)i;
+                const double h = grid.holdouts[f % H];
+                if (h > 0.0) {
+                    auto split = Dataset::split_holdout_rows(rows, h, grid.seed);
+                    rows = std::move(split.first);
+                    prune_rows[f] = std::move(split.second);
+                    // ascending ids keep each node's row range in memory order
+                    std::sort(rows.begin(), rows.end());
+                    std::sort(prune_rows[f].begin(), prune_rows[f].end());
+                }
+                if (grid.tree.n_threads > 1) fits[f].set_pool(pool);
+                fits[f].fit(train, rows, share_orders ? &orders : nullptr);
+            });
+        }
+        group.wait();
+    }
+
+    const size_t D = grid.max_depths.size(), M = grid.min_samples_splits.size();
+    std::vector<TunePoint> points(n_fits * D * M);
+    TaskGroup group(pool);
+    for (size_t j = 0; j < points.size(); ++j) {
+        group.run([&, j]() {
+            const size_t f = j / (D * M);
+            TunePoint& pt = points[j];
+            pt.criterion = grid.criteria[f / H];
+            pt.holdout = grid.holdouts[f % H];
+            pt.max_depth = grid.max_depths[(j / M) % D];
+            pt.min_samples_split = grid.min_samples_splits[j % M];
+
+            const DecisionTree tree = fits[f].truncated(pt.max_depth, pt.min_samples_split);
+            pt.n_nodes = tree.compiled().n_nodes();
+            pt.tree = tree.evaluate(validate);
+            auto rules = tree.extract_rules(train.spec);
+            pt.rules = tree.evaluate_rules(validate, rules, tree.default_class());
+            if (prune_rows[f].empty()) {
+                pt.pruned = pt.rules;
+            } else {
+                auto pruned = tree.post_prune_rules(train, prune_rows[f], rules, tree.default_class());
+                pt.pruned = tree.evaluate_rules(validate, pruned, tree.default_class());
+            }
+        });
+    }
+    group.wait();
+    return points;
+}
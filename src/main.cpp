@@ -1,25 +1,94 @@
 #include "Dataset.h"
+#include "CrossVal.h"
 #include "DecisionTree.h"
+#include "Experiment.h"
+#include "Forest.h"
 #include "Noise.h"
+#include "CodeGen.h"
 #include "Metrics.h"
+#include "Model.h"
+#include "Stats.h"
+#include "TaskPool.h"
+#include "TreeOptions.h"
+#include "Tune.h"
 #include "Util.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include <fstream>
 #include <cstring>
+#include <thread>
 
 static void usage() {
     std::cout <<
 R"(Usage:
   ./dtree testTennis  <attr> <train> <test>
-  ./dtree testIris    <attr> <train> <test> [--holdout 0.2] [--seed 1]
+  ./dtree testIris    <attr> <train> <test> [--holdout 0.2] [--seed 1] [tree options]
   ./dtree testIrisNoisy <attr> <train> <test> [--seed 1] [--holdout 0.2] [--out iris_noisy.csv]
+                      [--seeds 1] [--jobs N] [tree options]
+  ./dtree convert <attr> <data> <out.bin>
+  ./dtree train <attr> <train> --save model.bin [--holdout F] [--seed 1] [tree options]
+  ./dtree predict --model model.bin <data> [--rules] [--out predictions.txt]
+  ./dtree export <attr> <train> --out model.h [--namespace dtree_model] [--holdout F] [--seed 1]
+                 [tree options]
+  ./dtree forest <attr> <train> <test> [--trees 100] [--max-features N|sqrt|all] [--sample F]
+                 [--no-bootstrap] [--seed 1] [--noise P] [tree options]
+  ./dtree crossval <attr> <data> [--folds 10] [--holdout 0.2] [--seed 1] [--jobs N] [tree options]
+  ./dtree stream <attr> <train|-> [--test file] [--prune file] [--save model.bin] [--print]
+                 [--delta 1e-7] [--tie 0.05] [--grace 200] [--split-points 10] [--max-depth D]
+                 [--criterion entropy|gini]
+  ./dtree update <attr> <train> <new> [--batch-rows N] [--test file] [--print] [tree options]
+  ./dtree tune <attr> <train> <test> [--criteria entropy,gini,gain_ratio] [--holdouts 0,0.2,0.3]
+               [--depths 2,3,4,6,8,all] [--min-splits 2,4,8,16] [--seed 1] [--jobs N] [tree options]
+
+Every mode also accepts --stats (print instrumentation counters and phase times to stderr
+when it finishes) and --stats-json <file>; both need a build with make STATS=1.
+
+Tree options:
+  --criterion C    split criterion: entropy (default), gini or gain_ratio
+  --max-depth D    grow at most D levels below the root ("all", the default: no limit)
+  --min-split N    only split nodes with at least N training rows (default 2)
+  --presort        sort continuous columns once per fit instead of at every node
+  --bins N         histogram split finding with up to N quantile bins per continuous attribute
+  --threads N      build subtrees in parallel on N threads (same tree as serial)
 
 Notes:
 - testTennis: prints the tree, tree accuracy (train/test), rules, rule accuracy (train/test) (no pruning).
 - testIris:   prints tree, tree accuracy (train/test), rules after rule post-pruning, rule accuracy (train/test).
 - testIrisNoisy: corrupts training labels from 0%..20% in 2% increments; evaluates on uncorrupted test set
-  with and without rule post-pruning; outputs CSV for plotting.
+  with and without rule post-pruning; outputs CSV for plotting. Runs execute concurrently on
+  --jobs threads (default: all hardware threads); output order does not depend on it. With
+  --seeds R, every level is run with seeds seed..seed+R-1 and the CSV holds per-level means,
+  then standard deviations and the run count.
+- convert: writes <data> as a binary dataset file. Any <attr>, <train> or <test> argument
+  may be such a file; it is detected and mapped instead of parsed.
+- train: fits a tree and saves it as a model file. With --holdout F, a fraction F of <train>
+  is held out to post-prune the extracted rules, and the pruned rules are saved too.
+- predict: scores <data> with a saved model (its rules with --rules) and prints accuracy;
+  --out writes one predicted class label per row.
+- export: fits like train and writes the tree (and, with --holdout, the pruned rules) as a
+  self-contained C++ header of nested branches; see include/CodeGen.h.
+- forest: fits a single tree and a bagged random forest on <train> (with --noise P, after
+  corrupting P% of its labels) and prints both accuracies. Trees are fitted in parallel on
+  --threads threads (default: all hardware threads); the forest is the same for any count.
+- crossval: K-fold cross-validation of the tree, its rules and its post-pruned rules on one
+  dataset, printing per-fold test accuracies and their mean and variance. Within each training
+  fold a fraction --holdout (0 disables pruning) is held out to prune the rules. Folds run
+  concurrently on --jobs threads (default: all hardware threads); results do not depend on it.
+- stream: grows a Hoeffding tree reading <train> ("-" for stdin) once, in batches, without
+  holding its rows; see include/Hoeffding.h. A leaf is split when, after every --grace rows,
+  the Hoeffding bound for --delta separates its best attribute from the runner-up (or falls
+  below --tie). Rules are post-pruned on --prune, scored on --test, and saved with --save.
+- update: fits an incremental tree on <train>, then adds the rows of <new> to it with
+  DecisionTree::update, --batch-rows at a time (default: all at once), reporting how much of
+  the tree each update re-checked and refit. Not with --bins.
+- tune: scores every combination of the listed criteria, holdout fractions (for rule
+  post-pruning; 0 means none), depth limits and minimum split sizes on <test>, and prints
+  the best setting for the tree, the rules and the pruned rules. Only one tree is fitted per
+  criterion and holdout; the depth and split-size variants are cut from it.
 
 )";
 }
@@ -30,20 +99,53 @@ static double parse_double(const char* s) {
     return util::to_double(std::string(s));
 }
 static unsigned parse_uint(const char* s) {
-    char* end=nullptr;
-    unsigned long v = std::strtoul(s, &end, 10);
-    if (end==s || *end!='\0') throw std::runtime_error(std::string("Expected integer, got: ")+s);
-    return (unsigned)v;
+    return util::to_uint(std::string(s));
+}
+
+// comma-separated list, e.g. "2,4,8"
+static std::vector<std::string> split_list(const char* s) {
+    std::vector<std::string> out;
+    std::string cur;
+    for (const char* p = s; ; ++p) {
+        if (*p == ',' || *p == '\0') {
+            if (cur.empty()) throw std::runtime_error(std::string("Empty item in list: ") + s);
+            out.push_back(cur);
+            cur.clear();
+            if (*p == '\0') break;
+        } else {
+            cur += *p;
+        }
+    }
+    return out;
 }
 
 static void print_header(const std::string& title) {
     std::cout << "\n=== " << title << " ===\n";
 }
 
+// Loads the train and test files concurrently (large files are also parsed in chunks).
+// On failure the error is the one loading train, then test, would have raised first.
+static void load_train_test(const DatasetSpec& spec, const std::string& trainf, const std::string& testf,
+                            Dataset& train, Dataset& test) {
+    TaskPool pool((int)std::max(1u, std::thread::hardware_concurrency()));
+    std::exception_ptr errors[2];
+    TaskGroup group(&pool);
+    group.run([&]() {
+        try { train = Dataset::load_data(spec, trainf, &pool); } catch (...) { errors[0] = std::current_exception(); }
+    });
+    group.run([&]() {
+        try { test = Dataset::load_data(spec, testf, &pool); } catch (...) { errors[1] = std::current_exception(); }
+    });
+    group.wait();
+    for (const auto& e : errors) {
+        if (e) std::rethrow_exception(e);
+    }
+}
+
 static void run_testTennis(const std::string& attr, const std::string& trainf, const std::string& testf) {
     auto spec = Dataset::load_spec(attr);
-    auto train = Dataset::load_data(spec, trainf);
-    auto test  = Dataset::load_data(spec, testf);
+    Dataset train, test;
+    load_train_test(spec, trainf, testf, train, test);
 
     DecisionTree tree;
     tree.fit(train);
@@ -71,16 +173,16 @@ static void run_testTennis(const std::string& attr, const std::string& trainf, c
 }
 
 static void run_testIris(const std::string& attr, const std::string& trainf, const std::string& testf,
-                         double holdout, unsigned seed) {
+                         double holdout, unsigned seed, const TreeParams& params) {
     auto spec = Dataset::load_spec(attr);
-    auto full_train = Dataset::load_data(spec, trainf);
-    auto test  = Dataset::load_data(spec, testf);
+    Dataset full_train, test;
+    load_train_test(spec, trainf, testf, full_train, test);
 
     auto split = full_train.split_holdout(holdout, seed);
     auto train = split.first;
     auto prune = split.second;
 
-    DecisionTree tree;
+    DecisionTree tree(params);
     tree.fit(train);
 
     print_header("Decision Tree");
@@ -109,58 +211,385 @@ static void run_testIris(const std::string& attr, const std::string& trainf, con
     std::cout << "test : " << te_r.correct << "/" << te_r.total << " = " << fmt_pct(te_r.accuracy()) << "\n";
 }
 
+// test-set accuracies of one noise sweep run
+struct NoiseRun {
+    double tree = 0.0;
+    double rules = 0.0;
+    double pruned = 0.0;
+};
+
+// Every (noise level, seed) run of the sweep is an independent job on a pool shared with
+// the tree fits; they read the parsed clean train and test sets concurrently. Results are
+// written in sweep order. With n_seeds > 1, run r of a level uses seed + r, and each level
+// reports the mean and standard deviation over its runs.
 static void run_testIrisNoisy(const std::string& attr, const std::string& trainf, const std::string& testf,
-                              double holdout, unsigned seed, const std::string& out_csv) {
+                              double holdout, unsigned seed, int n_seeds, int jobs,
+                              const std::string& out_csv, const TreeParams& params) {
     auto spec = Dataset::load_spec(attr);
-    auto clean_train = Dataset::load_data(spec, trainf);
-    auto test  = Dataset::load_data(spec, testf);
+    Dataset clean_train, test;
+    load_train_test(spec, trainf, testf, clean_train, test);
 
     std::ofstream out(out_csv.c_str());
     if (!out) throw std::runtime_error("Failed to open output CSV: " + out_csv);
 
     // header
-    out << "noise_percent,tree_acc_test,rule_acc_test,pruned_rule_acc_test\n";
+    out << "noise_percent,tree_acc_test,rule_acc_test,pruned_rule_acc_test";
+    if (n_seeds > 1) out << ",tree_acc_std,rule_acc_std,pruned_rule_acc_std,runs";
+    out << "\n";
+
+    std::vector<int> levels;
+    for (int p = 0; p <= 20; p += 2) levels.push_back(p);
+    const size_t R = (size_t)n_seeds;
+
+    TaskPool pool(jobs);
+    std::function<NoiseRun(size_t)> job = [&](size_t j) {
+        const int p = levels[j / R];
+        const unsigned s = seed + (unsigned)(j % R);
 
-    for (int p = 0; p <= 20; p += 2) {
         Dataset noisy = clean_train;
-        corrupt_labels(noisy, (double)p, seed);
+        corrupt_labels(noisy, (double)p, s);
 
-        auto split = noisy.split_holdout(holdout, seed + 999u);
+        auto split = noisy.split_holdout(holdout, s + 999u);
         auto train = split.first;
         auto prune = split.second;
 
-        DecisionTree tree;
+        DecisionTree tree(params);
+        if (params.n_threads > 1) tree.set_pool(&pool);
         tree.fit(train);
 
-        auto tree_te = tree.evaluate(test);
+        NoiseRun r;
+        r.tree = tree.evaluate(test).accuracy();
 
         auto rules = tree.extract_rules(spec);
-        auto rule_te = tree.evaluate_rules(test, rules, tree.default_class());
+        r.rules = tree.evaluate_rules(test, rules, tree.default_class()).accuracy();
 
         auto pruned = tree.post_prune_rules(prune, rules, tree.default_class());
-        auto pruned_te = tree.evaluate_rules(test, pruned, tree.default_class());
+        r.pruned = tree.evaluate_rules(test, pruned, tree.default_class()).accuracy();
+        return r;
+    };
+
+    std::vector<NoiseRun> level_runs;
+    std::function<void(size_t, const NoiseRun&)> emit = [&](size_t j, const NoiseRun& r) {
+        level_runs.push_back(r);
+        if (level_runs.size() < R) return;
+        const int p = levels[j / R];
+
+        if (R == 1) {
+            out << p << ","
+                << r.tree << ","
+                << r.rules << ","
+                << r.pruned << "\n";
+
+            std::cout << std::left
+              << std::setw(10) << ("noise=" + std::to_string(p) + "%")
+              << " | "
+              << "test_acc(clean_test): "
+              << "tree=" << std::setw(7) << fmt_pct(r.tree) // Decision tree learned from noisy training data
+              << " | rules_no_prune=" << std::setw(7) << fmt_pct(r.rules)  // Rules extracted from that tree (no pruning)
+              << " | rules_post_prune=" << std::setw(7) << fmt_pct(r.pruned)  // Rules after post-pruning
+              << "\n";
+        } else {
+            double mean[3] = {0.0, 0.0, 0.0}, sd[3] = {0.0, 0.0, 0.0};
+            for (const NoiseRun& x : level_runs) {
+                mean[0] += x.tree; mean[1] += x.rules; mean[2] += x.pruned;
+            }
+            for (double& m : mean) m /= (double)R;
+            for (const NoiseRun& x : level_runs) {
+                const double d[3] = {x.tree - mean[0], x.rules - mean[1], x.pruned - mean[2]};
+                for (int k = 0; k < 3; ++k) sd[k] += d[k] * d[k];
+            }
+            for (double& v : sd) v = std::sqrt(v / (double)(R - 1));
+
+            out << p << "," << mean[0] << "," << mean[1] << "," << mean[2] << ","
+                << sd[0] << "," << sd[1] << "," << sd[2] << "," << R << "\n";
+
+            auto mean_sd = [](double m, double v) {
+                char buf[64];
+                std::snprintf(buf, sizeof(buf), "%.2f%% (sd %.2f)", m * 100.0, v * 100.0);
+                return std::string(buf);
+            };
+            std::cout << std::left
+              << std::setw(10) << ("noise=" + std::to_string(p) + "%")
+              << " | "
+              << "test_acc(clean_test), " << R << " seeds: "
+              << "tree=" << std::setw(17) << mean_sd(mean[0], sd[0])
+              << " | rules_no_prune=" << std::setw(17) << mean_sd(mean[1], sd[1])
+              << " | rules_post_prune=" << std::setw(17) << mean_sd(mean[2], sd[2])
+              << "\n";
+        }
+        level_runs.clear();
+    };
+    run_ordered(&pool, levels.size() * R, job, emit);
+
+    std::cout << "Wrote: " << out_csv << "\n";
+}
 
-        out << p << ","
-            << tree_te.accuracy() << ","
-            << rule_te.accuracy() << ","
-            << pruned_te.accuracy() << "\n";
+// Fits `tree` on <train>. With holdout > 0 it is fitted on the training part of the split
+// instead, and the extracted rules are post-pruned on the held-out part into `pruned`.
+static bool fit_with_rules(const std::string& attr, const std::string& trainf, double holdout, unsigned seed,
+                           DecisionTree& tree, Dataset& train, std::vector<DecisionTree::Rule>& pruned) {
+    auto spec = Dataset::load_spec(attr);
+    auto full_train = Dataset::load_data(spec, trainf);
 
-        std::cout << std::left
-          << std::setw(10) << ("noise=" + std::to_string(p) + "%")
-          << " | "
-          << "test_acc(clean_test): "
-          << "tree=" << std::setw(7) << fmt_pct(tree_te.accuracy()) // Decision tree learned from noisy training data
-          << " | rules_no_prune=" << std::setw(7) << fmt_pct(rule_te.accuracy())  // Rules extracted from that tree (no pruning)
-          << " | rules_post_prune=" << std::setw(7) << fmt_pct(pruned_te.accuracy())  // Rules after post-pruning
-          << "\n";
+    Dataset prune;
+    train = full_train;
+    if (holdout > 0.0) {
+        auto split = full_train.split_holdout(holdout, seed);
+        train = split.first;
+        prune = split.second;
+    }
 
+    tree.fit(train);
+    if (holdout <= 0.0) return false;
+    auto rules = tree.extract_rules(spec);
+    pruned = tree.post_prune_rules(prune, rules, tree.default_class());
+    return true;
+}
+
+static void run_train(const std::string& attr, const std::string& trainf, const std::string& model_path,
+                      double holdout, unsigned seed, const TreeParams& params) {
+    DecisionTree tree(params);
+    Dataset train;
+    std::vector<DecisionTree::Rule> pruned;
+    const bool has_rules = fit_with_rules(attr, trainf, holdout, seed, tree, train, pruned);
+    Model model(tree);
+    if (has_rules) model.set_rules(pruned, tree.default_class());
+    model.save(model_path);
 
+    auto tr_acc = tree.evaluate(train);
+    std::cout << "train: " << tr_acc.correct << "/" << tr_acc.total << " = " << fmt_pct(tr_acc.accuracy()) << "\n";
+    std::cout << "Wrote: " << model_path << " (" << model.tree.n_nodes() << " nodes";
+    if (model.has_rules) std::cout << ", " << model.rules.size() << " pruned rules";
+    std::cout << ")\n";
+}
+
+static void run_stream(const std::string& attr, const std::string& trainf, const std::string& testf,
+                       const std::string& prunef, const std::string& model_path, bool print,
+                       const HoeffdingParams& params) {
+    auto spec = Dataset::load_spec(attr);
+    DecisionTree tree;
+    const auto t0 = std::chrono::steady_clock::now();
+    tree.fit_stream(spec, trainf, params);
+    const double fit_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    long rows = 0;
+    for (int k = 0; k < tree.root()->n_classes; ++k) rows += tree.root()->class_counts[k];
+    std::cout << "streamed " << rows << " rows in " << std::fixed << std::setprecision(3) << fit_s
+              << " s: " << tree.compiled().n_nodes() << " nodes\n";
+    if (print) {
+        print_header("Tree");
+        tree.print_tree(spec);
     }
 
-    std::cout << "Wrote: " << out_csv << "\n";
+    auto rules = tree.extract_rules(spec);
+    std::vector<DecisionTree::Rule> pruned;
+    if (!prunef.empty()) {
+        Dataset prune = Dataset::load_data(spec, prunef);
+        pruned = tree.post_prune_rules(prune, rules, tree.default_class());
+    }
+    if (!testf.empty()) {
+        Dataset test = Dataset::load_data(spec, testf);
+        auto te_acc = tree.evaluate(test);
+        auto ru_acc = tree.evaluate_rules(test, rules, tree.default_class());
+        std::cout << "test (tree) : " << te_acc.correct << "/" << te_acc.total << " = " << fmt_pct(te_acc.accuracy()) << "\n";
+        std::cout << "test (rules): " << ru_acc.correct << "/" << ru_acc.total << " = " << fmt_pct(ru_acc.accuracy()) << "\n";
+        if (!prunef.empty()) {
+            auto pr_acc = tree.evaluate_rules(test, pruned, tree.default_class());
+            std::cout << "test (pruned rules): " << pr_acc.correct << "/" << pr_acc.total << " = "
+                      << fmt_pct(pr_acc.accuracy()) << "\n";
+        }
+    }
+    if (!model_path.empty()) {
+        Model model(tree);
+        if (!prunef.empty()) model.set_rules(pruned, tree.default_class());
+        model.save(model_path);
+        std::cout << "Wrote: " << model_path << "\n";
+    }
 }
 
-int main(int argc, char** argv) {
+static void run_update(const std::string& attr, const std::string& trainf, const std::string& newf,
+                       const std::string& testf, size_t batch_rows, bool print, TreeParams params) {
+    auto spec = Dataset::load_spec(attr);
+    Dataset train = Dataset::load_data(spec, trainf);
+    Dataset fresh = Dataset::load_data(spec, newf);
+    params.incremental = true;
+    DecisionTree tree(params);
+    auto t0 = std::chrono::steady_clock::now();
+    tree.fit(train);
+    const double fit_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "fit: " << train.size() << " rows in " << std::fixed << std::setprecision(3) << fit_s
+              << " s, " << tree.compiled().n_nodes() << " nodes\n";
+
+    if (batch_rows == 0) batch_rows = fresh.size();
+    for (size_t begin = 0; begin < fresh.size(); begin += batch_rows) {
+        const size_t end = std::min(fresh.size(), begin + batch_rows);
+        Dataset batch = Dataset::empty(spec);
+        batch.reserve(end - begin);
+        for (size_t r = begin; r < end; ++r) batch.append_row(fresh, r);
+        t0 = std::chrono::steady_clock::now();
+        const UpdateReport u = tree.update(batch);
+        const double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        std::cout << "update: " << u.rows << " rows in " << s << " s, " << u.nodes_checked << " splits re-checked, "
+                  << u.subtrees_rebuilt << " subtrees refit, " << u.rows_rescanned << " rows rescanned, "
+                  << tree.compiled().n_nodes() << " nodes\n";
+    }
+    if (print) {
+        print_header("Tree");
+        tree.print_tree(spec);
+    }
+    if (!testf.empty()) {
+        Dataset test = Dataset::load_data(spec, testf);
+        auto te_acc = tree.evaluate(test);
+        std::cout << "test : " << te_acc.correct << "/" << te_acc.total << " = " << fmt_pct(te_acc.accuracy()) << "\n";
+    }
+}
+
+static void run_export(const std::string& attr, const std::string& trainf, const std::string& out_path,
+                       const std::string& ns, double holdout, unsigned seed, const TreeParams& params) {
+    DecisionTree tree(params);
+    Dataset train;
+    std::vector<DecisionTree::Rule> pruned;
+    const bool has_rules = fit_with_rules(attr, trainf, holdout, seed, tree, train, pruned);
+
+    std::ofstream out(out_path.c_str());
+    if (!out) throw std::runtime_error("Failed to open output file: " + out_path);
+    export_cpp_header(out, tree, has_rules ? &pruned : nullptr, tree.default_class(), ns);
+    if (!out) throw std::runtime_error("Failed to write: " + out_path);
+    std::cout << "Wrote: " << out_path << "\n";
+}
+
+static void run_forest(const std::string& attr, const std::string& trainf, const std::string& testf,
+                       double noise, const ForestParams& params) {
+    auto spec = Dataset::load_spec(attr);
+    Dataset train, test;
+    load_train_test(spec, trainf, testf, train, test);
+    corrupt_labels(train, noise, params.seed);
+
+    TreeParams single_params = params.tree;
+    single_params.max_features = 0;
+    DecisionTree tree(single_params);
+    tree.fit(train);
+    auto tr_acc = tree.evaluate(train);
+    auto te_acc = tree.evaluate(test);
+    print_header("Single tree");
+    std::cout << "train: " << tr_acc.correct << "/" << tr_acc.total << " = " << fmt_pct(tr_acc.accuracy()) << "\n";
+    std::cout << "test : " << te_acc.correct << "/" << te_acc.total << " = " << fmt_pct(te_acc.accuracy()) << "\n";
+
+    Forest forest(params);
+    const auto t0 = std::chrono::steady_clock::now();
+    forest.fit(train);
+    const double fit_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    tr_acc = forest.evaluate(train);
+    te_acc = forest.evaluate(test);
+    print_header("Forest (" + std::to_string(params.n_trees) + " trees)");
+    std::cout << "fit  : " << std::fixed << std::setprecision(3) << fit_s << " s on "
+              << std::max(1, params.tree.n_threads) << " thread(s)\n";
+    std::cout << "train: " << tr_acc.correct << "/" << tr_acc.total << " = " << fmt_pct(tr_acc.accuracy()) << "\n";
+    std::cout << "test : " << te_acc.correct << "/" << te_acc.total << " = " << fmt_pct(te_acc.accuracy()) << "\n";
+}
+
+static void run_crossval(const std::string& attr, const std::string& dataf, int jobs,
+                         const CrossValParams& params) {
+    auto spec = Dataset::load_spec(attr);
+    TaskPool pool(jobs);
+    auto ds = Dataset::load_data(spec, dataf, &pool);
+
+    const auto t0 = std::chrono::steady_clock::now();
+    const CrossValResult cv = cross_validate(ds, params, &pool);
+    const double cv_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    print_header(std::to_string(params.folds) + "-fold cross-validation (" + std::to_string(ds.size()) + " rows)");
+    std::cout << std::left << std::setw(6) << "fold" << std::setw(10) << "tree"
+              << std::setw(10) << "rules" << "rules_post_prune\n";
+    for (size_t k = 0; k < cv.folds.size(); ++k) {
+        const FoldScores& f = cv.folds[k];
+        std::cout << std::setw(6) << (k + 1) << std::setw(10) << fmt_pct(f.tree.accuracy())
+                  << std::setw(10) << fmt_pct(f.rules.accuracy()) << fmt_pct(f.pruned.accuracy()) << "\n";
+    }
+    auto line = [](const char* name, const AccuracySpread& s) {
+        char buf[96];
+        std::snprintf(buf, sizeof(buf), "%-18s mean %.2f%%  variance %.6f  (sd %.2f)", name,
+                      s.mean * 100.0, s.variance, std::sqrt(s.variance) * 100.0);
+        std::cout << buf << "\n";
+    };
+    std::cout << "\n";
+    line("tree", cv.tree);
+    line("rules", cv.rules);
+    line("rules_post_prune", cv.pruned);
+    std::cout << "time : " << std::fixed << std::setprecision(3) << cv_s << " s on " << jobs << " thread(s)\n";
+}
+
+static void run_tune(const std::string& attr, const std::string& trainf, const std::string& testf,
+                     int jobs, const TuneGrid& grid) {
+    auto spec = Dataset::load_spec(attr);
+    Dataset train, test;
+    load_train_test(spec, trainf, testf, train, test);
+
+    TaskPool pool(jobs);
+    const auto t0 = std::chrono::steady_clock::now();
+    const std::vector<TunePoint> points = tune(train, test, grid, &pool);
+    const double tune_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    print_header("Grid search (" + std::to_string(points.size()) + " settings, " +
+                 std::to_string(grid.criteria.size() * grid.holdouts.size()) + " fits)");
+    auto depth_name = [](int d) { return d >= TreeParams().max_depth ? std::string("all") : std::to_string(d); };
+    std::cout << std::left << std::setw(11) << "criterion" << std::setw(9) << "holdout"
+              << std::setw(7) << "depth" << std::setw(11) << "min_split" << std::setw(7) << "nodes"
+              << std::setw(10) << "tree" << std::setw(10) << "rules" << "rules_post_prune\n";
+    size_t best[3] = {0, 0, 0};
+    for (size_t j = 0; j < points.size(); ++j) {
+        const TunePoint& pt = points[j];
+        std::ostringstream h;
+        h << pt.holdout;
+        std::cout << std::setw(11) << split_criterion_name(pt.criterion) << std::setw(9) << h.str()
+                  << std::setw(7) << depth_name(pt.max_depth) << std::setw(11) << pt.min_samples_split
+                  << std::setw(7) << pt.n_nodes << std::setw(10) << fmt_pct(pt.tree.accuracy())
+                  << std::setw(10) << fmt_pct(pt.rules.accuracy()) << fmt_pct(pt.pruned.accuracy()) << "\n";
+        // first best in grid order
+        if (pt.tree.accuracy() > points[best[0]].tree.accuracy()) best[0] = j;
+        if (pt.rules.accuracy() > points[best[1]].rules.accuracy()) best[1] = j;
+        if (pt.pruned.accuracy() > points[best[2]].pruned.accuracy()) best[2] = j;
+    }
+
+    std::cout << "\n";
+    const char* names[3] = {"tree", "rules", "rules_post_prune"};
+    for (int k = 0; k < 3; ++k) {
+        const TunePoint& pt = points[best[k]];
+        const AccuracyReport& acc = k == 0 ? pt.tree : k == 1 ? pt.rules : pt.pruned;
+        std::cout << "best " << std::setw(17) << names[k] << fmt_pct(acc.accuracy())
+                  << "  --criterion " << split_criterion_name(pt.criterion) << " --holdout " << pt.holdout
+                  << " --max-depth " << depth_name(pt.max_depth) << " --min-split " << pt.min_samples_split << "\n";
+    }
+    std::cout << "time : " << std::fixed << std::setprecision(3) << tune_s << " s on " << jobs << " thread(s)\n";
+}
+
+static void run_predict(const std::string& model_path, const std::string& dataf, bool use_rules,
+                        const std::string& out_path) {
+    const Model model = Model::load(model_path);
+    if (use_rules && !model.has_rules) throw std::runtime_error("Model has no rules: " + model_path);
+    auto ds = Dataset::load_data(model.spec, dataf);
+
+    std::vector<int> pred(ds.size());
+    if (use_rules) model.compiled_rules.predict_batch(ds, pred.data());
+    else model.tree.predict_batch(ds, pred.data());
+
+    AccuracyReport acc;
+    acc.total = (int)ds.size();
+    for (size_t i=0;i<ds.size();++i) {
+        if (pred[i] == ds.y[i]) acc.correct += 1;
+    }
+    std::cout << (use_rules ? "rules" : "tree") << ": " << acc.correct << "/" << acc.total
+              << " = " << fmt_pct(acc.accuracy()) << "\n";
+
+    if (!out_path.empty()) {
+        std::ofstream out(out_path.c_str());
+        if (!out) throw std::runtime_error("Failed to open output file: " + out_path);
+        for (int p : pred) out << model.spec.class_labels[p] << "\n";
+        std::cout << "Wrote: " << out_path << "\n";
+    }
+}
+
+static int run_mode(int argc, char** argv) {
     try {
         if (argc < 2) { usage(); return 1; }
         std::string mode = argv[1];
@@ -171,16 +600,197 @@ int main(int argc, char** argv) {
             return 0;
         }
 
+        if (mode == "convert") {
+            if (argc != 5) { usage(); return 1; }
+            auto spec = Dataset::load_spec(argv[2]);
+            auto ds = Dataset::load_data(spec, argv[3]);
+            ds.save_binary(argv[4]);
+            std::cout << "Wrote " << ds.size() << " rows to " << argv[4] << "\n";
+            return 0;
+        }
+
+        if (mode == "train") {
+            if (argc < 4) { usage(); return 1; }
+            double holdout = 0.0;
+            unsigned seed = 1;
+            std::string model_path;
+            TreeParams params;
+            for (int i=4;i<argc;i++) {
+                if (arg_eq(argv[i], "--save") && i+1<argc) { model_path = argv[++i]; }
+                else if (arg_eq(argv[i], "--holdout") && i+1<argc) { holdout = parse_double(argv[++i]); }
+                else if (arg_eq(argv[i], "--seed") && i+1<argc) { seed = parse_uint(argv[++i]); }
+                else if (parse_tree_option(argc, argv, i, params)) {}
+                else { throw std::runtime_error(std::string("Unknown arg: ") + argv[i]); }
+            }
+            if (model_path.empty()) throw std::runtime_error("train needs --save <model file>");
+            run_train(argv[2], argv[3], model_path, holdout, seed, params);
+            return 0;
+        }
+
+        if (mode == "stream") {
+            if (argc < 4) { usage(); return 1; }
+            std::string testf, prunef, model_path;
+            bool print = false;
+            HoeffdingParams params;
+            for (int i=4;i<argc;i++) {
+                if (arg_eq(argv[i], "--test") && i+1<argc) { testf = argv[++i]; }
+                else if (arg_eq(argv[i], "--prune") && i+1<argc) { prunef = argv[++i]; }
+                else if (arg_eq(argv[i], "--save") && i+1<argc) { model_path = argv[++i]; }
+                else if (arg_eq(argv[i], "--print")) { print = true; }
+                else if (arg_eq(argv[i], "--delta") && i+1<argc) { params.delta = parse_double(argv[++i]); }
+                else if (arg_eq(argv[i], "--tie") && i+1<argc) { params.tie_threshold = parse_double(argv[++i]); }
+                else if (arg_eq(argv[i], "--grace") && i+1<argc) { params.grace_period = (int)parse_uint(argv[++i]); }
+                else if (arg_eq(argv[i], "--split-points") && i+1<argc) { params.split_points = (int)parse_uint(argv[++i]); }
+                else if (arg_eq(argv[i], "--max-depth") && i+1<argc) {
+                    const std::string v = argv[++i];
+                    params.max_depth = v == "all" ? HoeffdingParams().max_depth : (int)parse_uint(v.c_str());
+                }
+                else if (arg_eq(argv[i], "--criterion") && i+1<argc) { params.criterion = parse_split_criterion(argv[++i]); }
+                else { throw std::runtime_error(std::string("Unknown arg: ") + argv[i]); }
+            }
+            run_stream(argv[2], argv[3], testf, prunef, model_path, print, params);
+            return 0;
+        }
+
+        if (mode == "update") {
+            if (argc < 5) { usage(); return 1; }
+            std::string testf;
+            size_t batch_rows = 0;
+            bool print = false;
+            TreeParams params;
+            for (int i=5;i<argc;i++) {
+                if (arg_eq(argv[i], "--test") && i+1<argc) { testf = argv[++i]; }
+                else if (arg_eq(argv[i], "--batch-rows") && i+1<argc) { batch_rows = parse_uint(argv[++i]); }
+                else if (arg_eq(argv[i], "--print")) { print = true; }
+                else if (parse_tree_option(argc, argv, i, params)) {}
+                else { throw std::runtime_error(std::string("Unknown arg: ") + argv[i]); }
+            }
+            run_update(argv[2], argv[3], argv[4], testf, batch_rows, print, params);
+            return 0;
+        }
+
+        if (mode == "export") {
+            if (argc < 4) { usage(); return 1; }
+            double holdout = 0.0;
+            unsigned seed = 1;
+            std::string out_path, ns = "dtree_model";
+            TreeParams params;
+            for (int i=4;i<argc;i++) {
+                if (arg_eq(argv[i], "--out") && i+1<argc) { out_path = argv[++i]; }
+                else if (arg_eq(argv[i], "--namespace") && i+1<argc) { ns = argv[++i]; }
+                else if (arg_eq(argv[i], "--holdout") && i+1<argc) { holdout = parse_double(argv[++i]); }
+                else if (arg_eq(argv[i], "--seed") && i+1<argc) { seed = parse_uint(argv[++i]); }
+                else if (parse_tree_option(argc, argv, i, params)) {}
+                else { throw std::runtime_error(std::string("Unknown arg: ") + argv[i]); }
+            }
+            if (out_path.empty()) throw std::runtime_error("export needs --out <header file>");
+            run_export(argv[2], argv[3], out_path, ns, holdout, seed, params);
+            return 0;
+        }
+
+        if (mode == "forest") {
+            if (argc < 5) { usage(); return 1; }
+            ForestParams params;
+            params.tree.n_threads = (int)std::max(1u, std::thread::hardware_concurrency());
+            double noise = 0.0;
+            for (int i=5;i<argc;i++) {
+                if (arg_eq(argv[i], "--trees") && i+1<argc) { params.n_trees = (int)parse_uint(argv[++i]); }
+                else if (arg_eq(argv[i], "--max-features") && i+1<argc) {
+                    const std::string v = argv[++i];
+                    if (v == "sqrt") params.tree.max_features = -1;
+                    else if (v == "all") params.tree.max_features = 0;
+                    else params.tree.max_features = (int)parse_uint(v.c_str());
+                }
+                else if (arg_eq(argv[i], "--sample") && i+1<argc) { params.sample_fraction = parse_double(argv[++i]); }
+                else if (arg_eq(argv[i], "--no-bootstrap")) { params.bootstrap = false; }
+                else if (arg_eq(argv[i], "--seed") && i+1<argc) { params.seed = parse_uint(argv[++i]); }
+                else if (arg_eq(argv[i], "--noise") && i+1<argc) { noise = parse_double(argv[++i]); }
+                else if (parse_tree_option(argc, argv, i, params.tree)) {}
+                else { throw std::runtime_error(std::string("Unknown arg: ") + argv[i]); }
+            }
+            run_forest(argv[2], argv[3], argv[4], noise, params);
+            return 0;
+        }
+
+        if (mode == "crossval") {
+            if (argc < 4) { usage(); return 1; }
+            CrossValParams params;
+            int jobs = (int)std::max(1u, std::thread::hardware_concurrency());
+            for (int i=4;i<argc;i++) {
+                if (arg_eq(argv[i], "--folds") && i+1<argc) { params.folds = (int)parse_uint(argv[++i]); }
+                else if (arg_eq(argv[i], "--holdout") && i+1<argc) { params.holdout = parse_double(argv[++i]); }
+                else if (arg_eq(argv[i], "--seed") && i+1<argc) { params.seed = parse_uint(argv[++i]); }
+                else if (arg_eq(argv[i], "--jobs") && i+1<argc) { jobs = std::max(1, (int)parse_uint(argv[++i])); }
+                else if (parse_tree_option(argc, argv, i, params.tree)) {}
+                else { throw std::runtime_error(std::string("Unknown arg: ") + argv[i]); }
+            }
+            run_crossval(argv[2], argv[3], jobs, params);
+            return 0;
+        }
+
+        if (mode == "tune") {
+            if (argc < 5) { usage(); return 1; }
+            TuneGrid grid;
+            grid.criteria = {SplitCriterion::Entropy, SplitCriterion::Gini, SplitCriterion::GainRatio};
+            grid.holdouts = {0.0, 0.2, 0.3};
+            grid.max_depths = {2, 3, 4, 6, 8, TreeParams().max_depth};
+            grid.min_samples_splits = {2, 4, 8, 16};
+            int jobs = (int)std::max(1u, std::thread::hardware_concurrency());
+            for (int i=5;i<argc;i++) {
+                if (arg_eq(argv[i], "--criteria") && i+1<argc) {
+                    grid.criteria.clear();
+                    for (const std::string& v : split_list(argv[++i])) grid.criteria.push_back(parse_split_criterion(v));
+                }
+                else if (arg_eq(argv[i], "--holdouts") && i+1<argc) {
+                    grid.holdouts.clear();
+                    for (const std::string& v : split_list(argv[++i])) grid.holdouts.push_back(parse_double(v.c_str()));
+                }
+                else if (arg_eq(argv[i], "--depths") && i+1<argc) {
+                    grid.max_depths.clear();
+                    for (const std::string& v : split_list(argv[++i])) {
+                        grid.max_depths.push_back(v == "all" ? TreeParams().max_depth : (int)parse_uint(v.c_str()));
+                    }
+                }
+                else if (arg_eq(argv[i], "--min-splits") && i+1<argc) {
+                    grid.min_samples_splits.clear();
+                    for (const std::string& v : split_list(argv[++i])) grid.min_samples_splits.push_back((int)parse_uint(v.c_str()));
+                }
+                else if (arg_eq(argv[i], "--seed") && i+1<argc) { grid.seed = parse_uint(argv[++i]); }
+                else if (arg_eq(argv[i], "--jobs") && i+1<argc) { jobs = std::max(1, (int)parse_uint(argv[++i])); }
+                else if (parse_tree_option(argc, argv, i, grid.tree)) {}
+                else { throw std::runtime_error(std::string("Unknown arg: ") + argv[i]); }
+            }
+            run_tune(argv[2], argv[3], argv[4], jobs, grid);
+            return 0;
+        }
+
+        if (mode == "predict") {
+            std::string model_path, dataf, out_path;
+            bool use_rules = false;
+            for (int i=2;i<argc;i++) {
+                if (arg_eq(argv[i], "--model") && i+1<argc) { model_path = argv[++i]; }
+                else if (arg_eq(argv[i], "--rules")) { use_rules = true; }
+                else if (arg_eq(argv[i], "--out") && i+1<argc) { out_path = argv[++i]; }
+                else if (dataf.empty() && argv[i][0] != '-') { dataf = argv[i]; }
+                else { throw std::runtime_error(std::string("Unknown arg: ") + argv[i]); }
+            }
+            if (model_path.empty() || dataf.empty()) { usage(); return 1; }
+            run_predict(model_path, dataf, use_rules, out_path);
+            return 0;
+        }
+
         if (mode == "testIris") {
             if (argc < 5) { usage(); return 1; }
             double holdout = 0.2;
             unsigned seed = 1;
+            TreeParams params;
             for (int i=5;i<argc;i++) {
                 if (arg_eq(argv[i], "--holdout") && i+1<argc) { holdout = parse_double(argv[++i]); }
                 else if (arg_eq(argv[i], "--seed") && i+1<argc) { seed = parse_uint(argv[++i]); }
+                else if (parse_tree_option(argc, argv, i, params)) {}
                 else { throw std::runtime_error(std::string("Unknown arg: ") + argv[i]); }
             }
-            run_testIris(argv[2], argv[3], argv[4], holdout, seed);
+            run_testIris(argv[2], argv[3], argv[4], holdout, seed, params);
             return 0;
         }
 
@@ -189,13 +799,19 @@ int main(int argc, char** argv) {
             double holdout = 0.2;
             unsigned seed = 1;
             std::string out_csv = "iris_noisy.csv";
+            int n_seeds = 1;
+            int jobs = (int)std::max(1u, std::thread::hardware_concurrency());
+            TreeParams params;
             for (int i=5;i<argc;i++) {
                 if (arg_eq(argv[i], "--holdout") && i+1<argc) { holdout = parse_double(argv[++i]); }
                 else if (arg_eq(argv[i], "--seed") && i+1<argc) { seed = parse_uint(argv[++i]); }
+                else if (arg_eq(argv[i], "--seeds") && i+1<argc) { n_seeds = std::max(1, (int)parse_uint(argv[++i])); }
+                else if (arg_eq(argv[i], "--jobs") && i+1<argc) { jobs = std::max(1, (int)parse_uint(argv[++i])); }
                 else if (arg_eq(argv[i], "--out") && i+1<argc) { out_csv = argv[++i]; }
+                else if (parse_tree_option(argc, argv, i, params)) {}
                 else { throw std::runtime_error(std::string("Unknown arg: ") + argv[i]); }
             }
-            run_testIrisNoisy(argv[2], argv[3], argv[4], holdout, seed, out_csv);
+            run_testIrisNoisy(argv[2], argv[3], argv[4], holdout, seed, n_seeds, jobs, out_csv, params);
             return 0;
         }
 
@@ -206,3 +822,30 @@ int main(int argc, char** argv) {
         return 2;
     }
 }
+
+// --stats and --stats-json are accepted by every mode: they are taken out of the arguments
+// and the report is written once the mode has finished.
+int main(int argc, char** argv) {
+    std::vector<char*> args;
+    bool stats_text = false;
+    std::string stats_json;
+    for (int i=0;i<argc;i++) {
+        if (arg_eq(argv[i], "--stats")) { stats_text = true; }
+        else if (arg_eq(argv[i], "--stats-json") && i+1<argc) { stats_json = argv[++i]; }
+        else { args.push_back(argv[i]); }
+    }
+    args.push_back(nullptr);
+
+    const int rc = run_mode((int)args.size() - 1, args.data());
+    if (stats_text) stats::report(std::cerr);
+    if (!stats_json.empty()) {
+        if (!stats::compiled_in()) stats::report(std::cerr);
+        std::ofstream out(stats_json.c_str());
+        if (!out) {
+            std::cerr << "Error: failed to open stats file: " << stats_json << "\n";
+            return rc ? rc : 2;
+        }
+        stats::report_json(out);
+    }
+    return rc;
+}